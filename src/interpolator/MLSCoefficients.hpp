@@ -15,198 +15,207 @@ double func(Coord& p) {
   return Z;
 }
 
-// polynomial basis vector
-KOKKOS_INLINE_FUNCTION
-void BasisPoly(ScratchVecView basis_monomial, Coord& p1) {
-  basis_monomial(0) = 1.0;
-  basis_monomial(1) = p1.x;
-  basis_monomial(2) = p1.y;
-  basis_monomial(3) = p1.x * p1.x;
-  basis_monomial(4) = p1.x * p1.y;
-  basis_monomial(5) = p1.y * p1.y;
-}
+// compactly supported radial basis functions of r = distance / cutoff
+enum class RadialBasis {
+  // Wu's C4 function (1-r)^6 (5r^5 + 30r^4 + 72r^3 + 82r^2 + 36r + 6)
+  Wu,
+  // Wendland's C2 function (1-r)^4 (4r + 1)
+  WendlandC2
+};
 
 // radial basis function
-KOKKOS_INLINE_FUNCTION
-double rbf(double r_sq, double rho_sq) {
-  double phi;
-  double r = sqrt(r_sq);
-  double rho = sqrt(rho_sq);
-  double ratio = r / rho;
-  double limit = 1 - ratio;
+template <RadialBasis kind = RadialBasis::Wu>
+KOKKOS_INLINE_FUNCTION double rbf(double r_sq, double rho_sq) {
+  const double ratio = sqrt(r_sq / rho_sq);
+  const double limit = 1 - ratio;
   if (limit < 0) {
-    phi = 0;
-
-  } else {
-    phi = 5 * pow(ratio, 5) + 30 * pow(ratio, 4) + 72 * pow(ratio, 3) +
-          82 * pow(ratio, 2) + 36 * ratio + 6;
-    phi = phi * pow(limit, 6);
-  }
-
-  return phi;
-}
-
-// create vandermondeMatrix
-KOKKOS_INLINE_FUNCTION
-void VandermondeMatrix(ScratchMatView V, ScratchMatView local_source_points,
-                       int j) {
-  int N = local_source_points.extent(0);
-  Coord source_point;
-  source_point.x = local_source_points(j, 0);
-  source_point.y = local_source_points(j, 1);
-  ScratchVecView basis_monomial = Kokkos::subview(V, j, Kokkos::ALL());
-  BasisPoly(basis_monomial, source_point);
-}
-
-// moment matrix
-KOKKOS_INLINE_FUNCTION
-void PTphiMatrix(ScratchMatView pt_phi, ScratchMatView V, ScratchVecView Phi,
-                 int j) {
-  int M = V.extent(0);
-  int N = V.extent(1);
-
-  ScratchVecView vandermonde_mat_row = Kokkos::subview(V, j, Kokkos::ALL());
-  for (int k = 0; k < N; k++) {
-    pt_phi(k, j) = vandermonde_mat_row(k) * Phi(j);
+    return 0;
   }
-}
-
-// radial basis function vector
-KOKKOS_INLINE_FUNCTION
-void PhiVector(ScratchVecView Phi, Coord target_point,
-               ScratchMatView local_source_points, int j,
-               double cuttoff_dis_sq) {
-  int N = local_source_points.extent(0);
-  double dx = target_point.x - local_source_points(j, 0);
-  double dy = target_point.y - local_source_points(j, 1);
-  double ds_sq = dx * dx + dy * dy;
-  Phi(j) = rbf(ds_sq, cuttoff_dis_sq);
-}
-
-// matrix matrix multiplication
-KOKKOS_INLINE_FUNCTION
-void MatMatMul(member_type team, ScratchMatView moment_matrix,
-               ScratchMatView pt_phi, ScratchMatView vandermonde) {
-  int M = pt_phi.extent(0);
-  int N = vandermonde.extent(1);
-  int K = pt_phi.extent(1);
-
-  Kokkos::parallel_for(Kokkos::ThreadVectorRange(team, M), [=](const int i) {
-    Kokkos::parallel_for(Kokkos::TeamThreadRange(team, N), [=](const int j) {
-      double sum = 0.0;
-      Kokkos::parallel_reduce(
-          Kokkos::ThreadVectorRange(team, K),
-          [=](const int k, double& lsum) {
-            lsum += pt_phi(i, k) * vandermonde(k, j);
-          },
-          sum);
-      moment_matrix(i, j) = sum;
-    });
-  });
-}
-
-// Matrix vector multiplication
-KOKKOS_INLINE_FUNCTION
-void MatVecMul(member_type team, ScratchVecView vector, ScratchMatView matrix,
-               ScratchVecView result) {
-  int M = matrix.extent(0);
-  int N = matrix.extent(1);
-  Kokkos::parallel_for(Kokkos::TeamThreadRange(team, N), [=](const int i) {
-    double sum = 0;
-    Kokkos::parallel_reduce(
-        Kokkos::ThreadVectorRange(team, M),
-        [=](const int j, double& lsum) { lsum += vector(j) * matrix(j, i); },
-        sum);
-    result(i) = sum;
-  });
-  // team.team_barrier();
-}
-
-// dot product
-KOKKOS_INLINE_FUNCTION
-void dot_product(member_type team, ScratchVecView result_sub,
-                 ScratchVecView exactSupportValues_sub, double& target_value) {
-  int N = result_sub.extent(0);
-  for (int j = 0; j < N; ++j) {
-    target_value += result_sub(j) * exactSupportValues_sub[j];
+  const double limit_sq = limit * limit;
+  if constexpr (kind == RadialBasis::Wu) {
+    const double phi =
+        ((((5 * ratio + 30) * ratio + 72) * ratio + 82) * ratio + 36) * ratio +
+        6;
+    return phi * limit_sq * limit_sq * limit_sq;
+  } else {
+    return (4 * ratio + 1) * limit_sq * limit_sq;
   }
 }
 
-// moment matrix
-KOKKOS_INLINE_FUNCTION
-void PtphiPMatrix(ScratchMatView moment_matrix, member_type team,
-                  ScratchMatView pt_phi, ScratchMatView vandermonde) {
-  int M = pt_phi.extent(0);
-  int N = vandermonde.extent(1);
-  int K = pt_phi.extent(1);
-
-  Kokkos::parallel_for(Kokkos::ThreadVectorRange(team, M), [=](const int i) {
-    Kokkos::parallel_for(Kokkos::TeamThreadRange(team, N), [=](const int j) {
-      double sum = 0.0;
-      Kokkos::parallel_reduce(
-          Kokkos::ThreadVectorRange(team, K),
-          [=](const int k, double& lsum) {
-            lsum += pt_phi(i, k) * vandermonde(k, j);
-          },
-          sum);
-      moment_matrix(i, j) = sum;
-    });
-  });
-}
-
-// inverse matrix
-KOKKOS_INLINE_FUNCTION
-void inverse_matrix(member_type team, ScratchMatView matrix,
-                    ScratchMatView lower, ScratchMatView forward_matrix,
-                    ScratchMatView solution) {
-  int N = matrix.extent(0);
-
-  for (int j = 0; j < N; ++j) {
-    Kokkos::single(Kokkos::PerTeam(team), [=]() {
-      double sum = 0;
-      for (int k = 0; k < j; ++k) {
-        sum += lower(j, k) * lower(j, k);
+// polynomial basis of at most the given degree. The monomials are ordered by
+// degree, i.e. 1, x, y, x^2, xy, y^2 in 2D
+template <int dim, int degree>
+struct MonomialBasis {
+  static_assert(dim == 2 || dim == 3, "MLS supports 2D and 3D points");
+  static_assert(degree >= 0 && degree <= 2,
+                "MLS supports constant, linear and quadratic bases");
+  static constexpr int size = degree == 0   ? 1
+                              : degree == 1 ? dim + 1
+                                            : (dim + 1) * (dim + 2) / 2;
+
+  KOKKOS_INLINE_FUNCTION
+  static void Evaluate(const double* x, double* basis) {
+    basis[0] = 1.0;
+    if constexpr (degree >= 1) {
+      for (int i = 0; i < dim; ++i) {
+        basis[1 + i] = x[i];
       }
-      lower(j, j) = sqrt(matrix(j, j) - sum);
-    });
-
-    team.team_barrier();
-
-    Kokkos::parallel_for(Kokkos::TeamVectorRange(team, j + 1, N), [=](int i) {
-      double inner_sum = 0;
-      for (int k = 0; k < j; ++k) {
-        inner_sum += lower(i, k) * lower(j, k);
+    }
+    if constexpr (degree >= 2) {
+      int k = dim + 1;
+      for (int i = 0; i < dim; ++i) {
+        for (int j = i; j < dim; ++j) {
+          basis[k++] = x[i] * x[j];
+        }
       }
-      lower(i, j) = (matrix(i, j) - inner_sum) / lower(j, j);
-      lower(j, i) = lower(i, j);
-    });
-
-    team.team_barrier();
+    }
+  }
+};
+
+// small symmetric matrix that lives in registers. Only the lower triangle is
+// stored
+template <int n>
+struct SymmetricMatrix {
+  static constexpr int size = n * (n + 1) / 2;
+  double data[size];
+
+  KOKKOS_INLINE_FUNCTION
+  SymmetricMatrix() {
+    for (int i = 0; i < size; ++i) {
+      data[i] = 0;
+    }
+  }
+  // requires i >= j
+  KOKKOS_INLINE_FUNCTION
+  double& operator()(int i, int j) { return data[i * (i + 1) / 2 + j]; }
+  KOKKOS_INLINE_FUNCTION
+  double operator()(int i, int j) const { return data[i * (i + 1) / 2 + j]; }
+
+  KOKKOS_INLINE_FUNCTION
+  SymmetricMatrix& operator+=(const SymmetricMatrix& other) {
+    for (int i = 0; i < size; ++i) {
+      data[i] += other.data[i];
+    }
+    return *this;
+  }
+  KOKKOS_INLINE_FUNCTION
+  void operator+=(const volatile SymmetricMatrix& other) volatile {
+    for (int i = 0; i < size; ++i) {
+      data[i] += other.data[i];
+    }
   }
+};
 
-  Kokkos::parallel_for(Kokkos::TeamThreadRange(team, N), [=](const int i) {
-    forward_matrix(i, i) = 1.0 / lower(i, i);
-    for (int j = i + 1; j < N; ++j) {
-      forward_matrix(j, i) = 0.0;  // Initialize to zero
+namespace Kokkos {
+template <int n>
+struct reduction_identity<SymmetricMatrix<n>> {
+  KOKKOS_FORCEINLINE_FUNCTION static SymmetricMatrix<n> sum() {
+    return SymmetricMatrix<n>();
+  }
+};
+}  // namespace Kokkos
+
+// solves m x = b in place with a Cholesky factorization. m is overwritten
+// with its factor. The loop bounds are compile time constants so they are
+// fully unrolled for the small bases used by MLS
+template <int n>
+KOKKOS_INLINE_FUNCTION void CholeskySolve(SymmetricMatrix<n>& m, double* x) {
+  for (int j = 0; j < n; ++j) {
+    double diagonal = m(j, j);
+    for (int k = 0; k < j; ++k) {
+      diagonal -= m(j, k) * m(j, k);
+    }
+    diagonal = sqrt(diagonal);
+    m(j, j) = diagonal;
+    for (int i = j + 1; i < n; ++i) {
+      double sum = m(i, j);
       for (int k = 0; k < j; ++k) {
-        forward_matrix(j, i) -= lower(j, k) * forward_matrix(k, i);
+        sum -= m(i, k) * m(j, k);
       }
-      forward_matrix(j, i) /= lower(j, j);
+      m(i, j) = sum / diagonal;
+    }
+  }
+  // forward substitution L y = b
+  for (int i = 0; i < n; ++i) {
+    for (int k = 0; k < i; ++k) {
+      x[i] -= m(i, k) * x[k];
+    }
+    x[i] /= m(i, i);
+  }
+  // backward substitution L^T x = y
+  for (int i = n - 1; i >= 0; --i) {
+    for (int k = i + 1; k < n; ++k) {
+      x[i] -= m(k, i) * x[k];
     }
-  });
+    x[i] /= m(i, i);
+  }
+}
 
-  team.team_barrier();
+// basis of a support point shifted to the target point. Returns the radial
+// weight of the support
+template <int dim, int degree, RadialBasis kind, typename Coordinates>
+KOKKOS_INLINE_FUNCTION double SupportBasis(const double* target_point,
+                                           const Coordinates& coordinates,
+                                           int index, double cutoff_dis_sq,
+                                           double* basis) {
+  double dx[dim];
+  double ds_sq = 0;
+  for (int k = 0; k < dim; ++k) {
+    dx[k] = coordinates[index * dim + k] - target_point[k];
+    ds_sq += dx[k] * dx[k];
+  }
+  MonomialBasis<dim, degree>::Evaluate(dx, basis);
+  return rbf<kind>(ds_sq, cutoff_dis_sq);
+}
 
-  Kokkos::parallel_for(Kokkos::TeamThreadRange(team, N), [=](const int i) {
-    solution(N - 1, i) = forward_matrix(N - 1, i) / lower(N - 1, N - 1);
-    for (int j = N - 2; j >= 0; --j) {
-      solution(j, i) = forward_matrix(j, i);
-      for (int k = j + 1; k < N; ++k) {
-        solution(j, i) -= lower(j, k) * solution(k, i);
-      }
-      solution(j, i) /= lower(j, j);
-    }
-  });
+// MLS coefficients of the supports [start_ptr, end_ptr) of one target
+// point, i.e. phi_j p_j^T (P^T Phi P)^-1 p(target). The basis is centered at
+// the target point, so p(target) is the first unit vector. The team threads
+// share the work over the supports and the moment matrix and its solve stay
+// in registers, so no scratch memory is needed
+template <int dim, int degree, RadialBasis kind, typename Coordinates,
+          typename Supports, typename Coefficients>
+KOKKOS_INLINE_FUNCTION void MLSTargetCoefficients(
+    const member_type& team, const double* target_point,
+    const Coordinates& source_coordinates, const Supports& supports_idx,
+    int start_ptr, int end_ptr, double cutoff_dis_sq,
+    const Coefficients& coefficients) {
+  constexpr int n = MonomialBasis<dim, degree>::size;
+  SymmetricMatrix<n> moment_matrix;
+  Kokkos::parallel_reduce(
+      Kokkos::TeamThreadRange(team, start_ptr, end_ptr),
+      [=](const int j, SymmetricMatrix<n>& sum) {
+        double basis[n];
+        const double phi = SupportBasis<dim, degree, kind>(
+            target_point, source_coordinates, supports_idx[j], cutoff_dis_sq,
+            basis);
+        for (int a = 0; a < n; ++a) {
+          for (int b = 0; b <= a; ++b) {
+            sum(a, b) += phi * basis[a] * basis[b];
+          }
+        }
+      },
+      moment_matrix);
+
+  double solution[n];
+  solution[0] = 1.0;
+  for (int a = 1; a < n; ++a) {
+    solution[a] = 0.0;
+  }
+  CholeskySolve<n>(moment_matrix, solution);
+
+  Kokkos::parallel_for(
+      Kokkos::TeamThreadRange(team, start_ptr, end_ptr), [=](const int j) {
+        double basis[n];
+        const double phi = SupportBasis<dim, degree, kind>(
+            target_point, source_coordinates, supports_idx[j], cutoff_dis_sq,
+            basis);
+        double sum = 0;
+        for (int a = 0; a < n; ++a) {
+          sum += basis[a] * solution[a];
+        }
+        coefficients[j] = phi * sum;
+      });
 }
 
 #endif
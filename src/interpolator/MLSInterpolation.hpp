@@ -6,182 +6,185 @@
 #include "adj_search.hpp"
 #include "points.hpp"
 
+#include <Omega_h_fail.hpp>
+#include <algorithm>
+#include <string>
+#include <vector>
+
 using namespace Omega_h;
 using namespace pcms;
 
-Write<Real> mls_interpolation(const Reals source_values,
-                              const Reals source_coordinates,
-                              const Reals target_coordinates,
-                              const SupportResults& support, const LO& dim,
-                              Write<Real> radii2) {
-  const auto nvertices_source = source_coordinates.size() / dim;
-  const auto nvertices_target = target_coordinates.size() / dim;
+// MLS approximation as a sparse matrix. Row i holds the coefficients of the
+// supports of target i and is aligned with the supports of SupportResults, so
+// target i is sum(coefficients[j] * source_values[supports_idx[j]]) for j in
+// [supports_ptr[i], supports_ptr[i+1])
+struct MLSOperator {
+  SupportResults support;
+  Write<Real> coefficients;
+};
+
+// MLS coefficients of every target with one team per target. The targets are
+// bucketed by their number of supports, with bucket b holding the targets
+// with [2^b, 2^(b+1)) supports. Each bucket gets its own launch with a team
+// size that matches its supports, so a few targets with many supports do not
+// set the team size of every target
+template <int dim, int degree, RadialBasis kind>
+void mls_coefficients(const Reals source_coordinates,
+                      const Reals target_coordinates,
+                      const SupportResults& support, Write<Real> radii2,
+                      Write<Real> coefficients) {
+  const LO nvertices_target = target_coordinates.size() / dim;
+  const auto supports_ptr = support.supports_ptr;
+  const auto supports_idx = support.supports_idx;
+  constexpr int nbasis = MonomialBasis<dim, degree>::size;
+
+  HostRead<LO> supports_ptr_h(Read<LO>(supports_ptr));
+  std::vector<std::vector<LO>> buckets;
+  for (LO i = 0; i < nvertices_target; ++i) {
+    const LO nsupports = supports_ptr_h[i + 1] - supports_ptr_h[i];
+    if (nsupports < nbasis) {
+      Omega_h_fail(
+          "MLS target %d has %d supports but the basis needs at least %d\n",
+          i, nsupports, nbasis);
+    }
+    int bucket = 0;
+    while ((LO(2) << bucket) <= nsupports) {
+      ++bucket;
+    }
+    if (bucket >= static_cast<int>(buckets.size())) {
+      buckets.resize(bucket + 1);
+    }
+    buckets[bucket].push_back(i);
+  }
+
+  for (std::size_t bucket = 0; bucket < buckets.size(); ++bucket) {
+    const LO ntargets = buckets[bucket].size();
+    if (ntargets == 0) {
+      continue;
+    }
+    HostWrite<LO> targets_h(ntargets, "targets of the bucket");
+    std::copy(buckets[bucket].begin(), buckets[bucket].end(),
+              targets_h.data());
+    const Read<LO> targets(targets_h.write());
+
+    auto kernel = KOKKOS_LAMBDA(const member_type& team) {
+      const int i = targets[team.league_rank()];
+      double target_point[dim];
+      for (int k = 0; k < dim; ++k) {
+        target_point[k] = target_coordinates[i * dim + k];
+      }
+      MLSTargetCoefficients<dim, degree, kind>(
+          team, target_point, source_coordinates, supports_idx,
+          supports_ptr[i], supports_ptr[i + 1], radii2[i], coefficients);
+    };
+    // one thread for every one to two supports of the bucket
+    const int team_size =
+        std::min(team_policy(ntargets, 1)
+                     .team_size_max(kernel, Kokkos::ParallelForTag()),
+                 1 << bucket);
+    const std::string label = "MLS coefficients with " +
+                              std::to_string(1 << bucket) + " to " +
+                              std::to_string((2 << bucket) - 1) + " supports";
+    Kokkos::parallel_for(label, team_policy(ntargets, team_size), kernel);
+  }
+}
 
-  // Kokkos::RangePolicy<Kokkos::DefaultExecutionSpace> range_policy(1,
-  // nvertices_target);
+// builds the MLS coefficients of every target. This only depends on the
+// source and target coordinates, so the operator can be reused for any
+// number of fields with mls_apply
+template <int degree = 2, RadialBasis kind = RadialBasis::Wu>
+MLSOperator mls_setup(const Reals source_coordinates,
+                      const Reals target_coordinates,
+                      const SupportResults& support, const LO& dim,
+                      Write<Real> radii2) {
+  OMEGA_H_CHECK(dim == 2 || dim == 3);
+  Write<Real> coefficients(support.supports_idx.size(), 0,
+                           "MLS coefficients of each support");
+  if (dim == 2) {
+    mls_coefficients<2, degree, kind>(source_coordinates, target_coordinates,
+                                      support, radii2, coefficients);
+  } else {
+    mls_coefficients<3, degree, kind>(source_coordinates, target_coordinates,
+                                      support, radii2, coefficients);
+  }
+  return MLSOperator{support, coefficients};
+}
 
-  Kokkos::View<size_t*> shmem_each_team(
-      "stores the size required for each team", nvertices_target);
-  // Write<int> shmem_each_team(nvertices_target, 0, "stores the size required
-  // for each team member");
-
-  Kokkos::parallel_for(
-      "calculate the size required for scratch for each team", nvertices_target,
-      KOKKOS_LAMBDA(const int i) {
-        int start_ptr = support.supports_ptr[i];
-        int end_ptr = support.supports_ptr[i + 1];
-        int nsupports = end_ptr - start_ptr;
-
-        size_t total_shared_size = 0;
-
-        total_shared_size += ScratchMatView::shmem_size(6, 6) * 4;
-        total_shared_size += ScratchMatView::shmem_size(6, nsupports) * 2;
-        total_shared_size += ScratchMatView::shmem_size(nsupports, 6);
-        total_shared_size += ScratchVecView::shmem_size(6);
-        total_shared_size += ScratchVecView::shmem_size(nsupports) * 3;
-        total_shared_size += ScratchMatView::shmem_size(nsupports, 2);
-        shmem_each_team(i) = total_shared_size;
-      });
-
-  size_t shared_size;
-  Kokkos::parallel_reduce(
-      "find_max", nvertices_target,
-      KOKKOS_LAMBDA(const int i, size_t& max_val_temp) {
-        if (shmem_each_team(i) > max_val_temp) {
-          max_val_temp = shmem_each_team(i);
-        }
-      },
-      Kokkos::Max<size_t>(shared_size));
-  printf("shared size = %d \n", shared_size);
+// applies the MLS operator to the source values. This is a sparse matrix
+// vector product
+inline Write<Real> mls_apply(const MLSOperator& mls_operator,
+                             const Reals source_values) {
+  const auto supports_ptr = mls_operator.support.supports_ptr;
+  const auto supports_idx = mls_operator.support.supports_idx;
+  const auto coefficients = mls_operator.coefficients;
+  const auto nvertices_target = supports_ptr.size() - 1;
 
   Write<Real> approx_target_values(nvertices_target, 0,
                                    "approximated target values");
 
-  team_policy tp(nvertices_target, Kokkos::AUTO);
-
-  int scratch_size = tp.scratch_size_max(0);
-  printf("scratch size is %d \n", scratch_size);
-
   Kokkos::parallel_for(
-      "MLS coefficients", tp.set_scratch_size(0, Kokkos::PerTeam(shared_size)),
-      KOKKOS_LAMBDA(const member_type& team) {
-        int i = team.league_rank();
-        int start_ptr = support.supports_ptr[i];
-        int end_ptr = support.supports_ptr[i + 1];
-
-        int nsupports = end_ptr - start_ptr;
-
-        ScratchMatView local_source_points(team.team_scratch(0), nsupports, 2);
-        int count = -1;
-        for (int j = start_ptr; j < end_ptr; ++j) {
-          count++;
-          auto index = support.supports_idx[j];
-          local_source_points(count, 0) = source_coordinates[index * dim];
-          local_source_points(count, 1) = source_coordinates[index * dim + 1];
+      "MLS apply", nvertices_target, KOKKOS_LAMBDA(const int i) {
+        double tgt_value = 0;
+        for (int j = supports_ptr[i]; j < supports_ptr[i + 1]; ++j) {
+          tgt_value += coefficients[j] * source_values[supports_idx[j]];
         }
+        approx_target_values[i] = tgt_value;
+      });
 
-        ScratchMatView lower(team.team_scratch(0), 6, 6);
-
-        ScratchMatView forward_matrix(team.team_scratch(0), 6, 6);
-
-        ScratchMatView moment_matrix(team.team_scratch(0), 6, 6);
-
-        ScratchMatView inv_mat(team.team_scratch(0), 6, 6);
-
-        ScratchMatView V(team.team_scratch(0), nsupports, 6);
-
-        ScratchMatView Ptphi(team.team_scratch(0), 6, nsupports);
-
-        ScratchMatView resultant_matrix(team.team_scratch(0), 6, nsupports);
-
-        ScratchVecView targetMonomialVec(team.team_scratch(0), 6);
-
-        ScratchVecView SupportValues(team.team_scratch(0), nsupports);
-
-        ScratchVecView result(team.team_scratch(0), nsupports);
-
-        ScratchVecView Phi(team.team_scratch(0), nsupports);
-
-        Kokkos::parallel_for(Kokkos::TeamThreadRange(team, 6), [=](int j) {
-          for (int k = 0; k < 6; ++k) {
-            lower(j, k) = 0;
-            forward_matrix(j, k) = 0;
-            moment_matrix(j, k) = 0;
-            inv_mat(j, k) = 0;
-          }
+  return approx_target_values;
+}
 
-          targetMonomialVec(j) = 0;
-          for (int k = 0; k < nsupports; ++k) {
-            resultant_matrix(j, k) = 0;
+// applies the MLS operator to several fields that share the source and
+// target points. source_values has one row per source point and one column
+// per field. Each coefficient is loaded once for all of the fields
+inline Kokkos::View<Real**> mls_apply(
+    const MLSOperator& mls_operator,
+    Kokkos::View<const Real**> source_values) {
+  const auto supports_ptr = mls_operator.support.supports_ptr;
+  const auto supports_idx = mls_operator.support.supports_idx;
+  const auto coefficients = mls_operator.coefficients;
+  const auto nvertices_target = supports_ptr.size() - 1;
+  const int nfields = source_values.extent(1);
+
+  Kokkos::View<Real**> approx_target_values("approximated target values",
+                                            nvertices_target, nfields);
 
-            Ptphi(j, k) = 0;
+  Kokkos::parallel_for(
+      "MLS apply fields", nvertices_target, KOKKOS_LAMBDA(const int i) {
+        for (int j = supports_ptr[i]; j < supports_ptr[i + 1]; ++j) {
+          const double coefficient = coefficients[j];
+          const int source = supports_idx[j];
+          for (int f = 0; f < nfields; ++f) {
+            approx_target_values(i, f) +=
+                coefficient * source_values(source, f);
           }
-        });
-
-        Kokkos::parallel_for(Kokkos::TeamThreadRange(team, nsupports),
-                             [=](int j) {
-                               for (int k = 0; k < 6; ++k) {
-                                 V(j, k) = 0;
-                               }
-
-                               SupportValues(j) = 0;
-                               result(j) = 0;
-                               Phi(j) = 0;
-                             });
-
-        Coord target_point;
-
-        target_point.x = target_coordinates[i * dim];
-
-        target_point.y = target_coordinates[i * dim + 1];
-
-        BasisPoly(targetMonomialVec, target_point);
-
-        Kokkos::parallel_for(
-            Kokkos::TeamThreadRange(team, nsupports),
-            [=](int j) { VandermondeMatrix(V, local_source_points, j); });
-
-        team.team_barrier();
-
-        Kokkos::parallel_for(
-            Kokkos::TeamThreadRange(team, nsupports), [=](int j) {
-              PhiVector(Phi, target_point, local_source_points, j, radii2[i]);
-            });
-
-        team.team_barrier();
-
-        Kokkos::parallel_for(Kokkos::TeamThreadRange(team, nsupports),
-                             [=](int j) { PTphiMatrix(Ptphi, V, Phi, j); });
-
-        team.team_barrier();
-
-        MatMatMul(team, moment_matrix, Ptphi, V);
-        team.team_barrier();
-
-        inverse_matrix(team, moment_matrix, lower, forward_matrix, inv_mat);
-
-        team.team_barrier();
-
-        MatMatMul(team, resultant_matrix, inv_mat, Ptphi);
-        team.team_barrier();
-
-        MatVecMul(team, targetMonomialVec, resultant_matrix, result);
-        team.team_barrier();
-
-        Kokkos::parallel_for(
-            Kokkos::TeamThreadRange(team, nsupports), [=](const int i) {
-              SupportValues(i) =
-                  source_values[support.supports_idx[start_ptr + i]];
-            });
-
-        double tgt_value = 0;
-        dot_product(team, result, SupportValues, tgt_value);
-        if (team.team_rank() == 0) {
-          approx_target_values[i] = tgt_value;
         }
       });
 
   return approx_target_values;
 }
 
+inline Write<Real> mls_interpolation(const Reals source_values,
+                                     const Reals source_coordinates,
+                                     const Reals target_coordinates,
+                                     const SupportResults& support,
+                                     const LO& dim, Write<Real> radii2) {
+  return mls_apply(mls_setup(source_coordinates, target_coordinates, support,
+                             dim, radii2),
+                   source_values);
+}
+
+// interpolates several fields that share the source and target points. The
+// moment matrix of each target is solved once for all of the fields
+inline Kokkos::View<Real**> mls_interpolation(
+    Kokkos::View<const Real**> source_values, const Reals source_coordinates,
+    const Reals target_coordinates, const SupportResults& support,
+    const LO& dim, Write<Real> radii2) {
+  OMEGA_H_CHECK(static_cast<LO>(source_values.extent(0)) ==
+                source_coordinates.size() / dim);
+  return mls_apply(mls_setup(source_coordinates, target_coordinates, support,
+                             dim, radii2),
+                   source_values);
+}
+
 #endif
@@ -4,6 +4,7 @@
 #include <pcms/point_search.h>
 
 #include "queue_visited.hpp"
+#include <cstdio>
 
 using namespace Omega_h;
 
@@ -37,10 +38,10 @@ class FindSupports {
                       Write<LO>& nSupports, Write<LO>& support_idx);
 };
 
-void FindSupports::adjBasedSearch(const Real& cutoffDistance,
-                                  const Write<LO>& supports_ptr,
-                                  Write<LO>& nSupports,
-                                  Write<LO>& support_idx) {
+inline void FindSupports::adjBasedSearch(const Real& cutoffDistance,
+                                         const Write<LO>& supports_ptr,
+                                         Write<LO>& nSupports,
+                                         Write<LO>& support_idx) {
   //  Source Mesh Info
 
   const auto& sourcePoints_coords = source_mesh.coords();
@@ -71,24 +72,31 @@ void FindSupports::adjBasedSearch(const Real& cutoffDistance,
         target_points(i, 1) = targetPoints_coords[i * dim + 1];
       });
   Kokkos::fence();
-  pcms::GridPointSearch search_cell(source_mesh, 10, 10);
+  pcms::GridPointSearch search_cell(source_mesh);
 
   // get the cell id for each target point
   auto results = search_cell(target_points);
 
+  // set for the targets whose search exceeded the size of the queue or of the
+  // visited set
+  Write<LO> overflowed(nvertices_target, 0, "support search overflow");
+
   parallel_for(
       nvertices_target,
       OMEGA_H_LAMBDA(const LO id) {
         queue queue;
         track visited;
 
-        LO source_cell_id = results(id).tri_id;
+        LO source_cell_id = results(id).ElementId();
 
         const LO num_verts_in_dim = dim + 1;
 
-        LO start_ptr = source_cell_id * num_verts_in_dim;
+        // no cell is found when the source mesh has no elements
+        LO start_ptr =
+            (source_cell_id >= 0) ? source_cell_id * num_verts_in_dim : 0;
 
-        LO end_ptr = start_ptr + num_verts_in_dim;
+        LO end_ptr =
+            (source_cell_id >= 0) ? start_ptr + num_verts_in_dim : start_ptr;
 
         Real target_coords[max_dim];
 
@@ -127,7 +135,8 @@ void FindSupports::adjBasedSearch(const Real& cutoffDistance,
           }
         }
 
-        while (!queue.isEmpty()) {
+        while (!queue.isEmpty() && !queue.overflowed() &&
+               !visited.overflowed()) {
           LO currentVertex = queue.front();
           queue.pop_front();
           LO start = v2v_ptr[currentVertex];
@@ -160,9 +169,23 @@ void FindSupports::adjBasedSearch(const Real& cutoffDistance,
           }
         }  // end of while loop
 
+        if (queue.overflowed() || visited.overflowed()) {
+          overflowed[id] = 1;
+        }
         nSupports[id] = count;
       },
       "count the number of supports in each target point");
+
+  const LO noverflowed = get_sum(Read<LO>(overflowed));
+  if (noverflowed > 0) {
+    // the original search also kept the supports found before the lists
+    // were full, so this is not an error
+    fprintf(stderr,
+            "warning: support search of %d targets visited more than %d "
+            "entities or queued more than %d. Only the supports found "
+            "before the limit are used, reduce the cutoff distance\n",
+            noverflowed, MAX_SIZE_TRACK, MAX_SIZE_QUEUE);
+  }
 }
 
 struct SupportResults {
@@ -170,8 +193,8 @@ struct SupportResults {
   Write<LO> supports_idx;
 };
 
-SupportResults searchNeighbors(Mesh& source_mesh, Mesh& target_mesh,
-                               Real& cutoffDistance) {
+inline SupportResults searchNeighbors(Mesh& source_mesh, Mesh& target_mesh,
+                                      Real& cutoffDistance) {
   SupportResults support;
 
   FindSupports search(source_mesh, target_mesh);
@@ -1,10 +1,13 @@
 #ifndef ADJ_SEARCH_HPP
 #define ADJ_SEARCH_HPP
 
+#include <Omega_h_array_ops.hpp>
 #include <Omega_h_macros.h>
+#include <Omega_h_map.hpp>
 #include <pcms/point_search.h>
 
 #include "queue_visited.hpp"
+#include <cstdio>
 
 using namespace Omega_h;
 
@@ -28,34 +31,38 @@ Real calculateDistance(const Real* p1, const Real* p2, const int dim) {
 class FindSupports {
  private:
   Mesh& mesh;
+  // the support points are the cell centroids, which are computed once
+  Write<Real> cell_centroids;
 
  public:
-  FindSupports(Mesh& mesh_) : mesh(mesh_) {};
+  FindSupports(Mesh& mesh_);
 
+  // search the supports of the target vertices in targets. The supports are
+  // only counted into nSupports when is_build_csr_call is true and are
+  // written to support_idx otherwise
   void adjBasedSearch(Write<LO>& supports_ptr, Write<LO>& nSupports,
                       Write<LO>& support_idx, Write<Real>& radii2,
-                      bool is_build_csr_call);
+                      bool is_build_csr_call, Read<LO> targets);
+
+  // search the supports of every vertex
+  void adjBasedSearch(Write<LO>& supports_ptr, Write<LO>& nSupports,
+                      Write<LO>& support_idx, Write<Real>& radii2,
+                      bool is_build_csr_call) {
+    adjBasedSearch(supports_ptr, nSupports, support_idx, radii2,
+                   is_build_csr_call, LOs(mesh.nverts(), 0, 1));
+  }
 };
 
-void FindSupports::adjBasedSearch(Write<LO>& supports_ptr, Write<LO>& nSupports,
-                                  Write<LO>& support_idx, Write<Real>& radii2,
-                                  bool is_build_csr_call) {
-  // Mesh Info
-  LO min_num_supports = 20;  // TODO: make this an input parameter
+inline FindSupports::FindSupports(Mesh& mesh_) : mesh(mesh_) {
   const auto& mesh_coords = mesh.coords();
-  const auto& nvertices = mesh.nverts();
   const auto& dim = mesh.dim();
   const auto& nfaces = mesh.nfaces();
-
-  // CSR data structure of adjacent cell information of each vertex in a mesh
-  const auto& nodes2faces = mesh.ask_up(VERT, FACE);
-  const auto& n2f_ptr = nodes2faces.a2ab;
-  const auto& n2f_data = nodes2faces.ab2b;
   const auto& faces2nodes = mesh.ask_down(FACE, VERT).ab2b;
 
-  Write<Real> cell_centroids(
+  cell_centroids = Write<Real>(
       dim * nfaces, 0,
       "stores coordinates of cell centroid of each tri element");
+  auto cell_centroids = this->cell_centroids;
 
   parallel_for(
       "calculate the centroid in each tri element", nfaces,
@@ -68,11 +75,34 @@ void FindSupports::adjBasedSearch(Write<LO>& supports_ptr, Write<LO>& nSupports,
         cell_centroids[index] = centroid[0];
         cell_centroids[index + 1] = centroid[1];
       });
-  // * Got the adj data and cell centroids
+}
+
+inline void FindSupports::adjBasedSearch(Write<LO>& supports_ptr,
+                                         Write<LO>& nSupports,
+                                         Write<LO>& support_idx,
+                                         Write<Real>& radii2,
+                                         bool is_build_csr_call,
+                                         Read<LO> targets) {
+  // Mesh Info
+  const auto& mesh_coords = mesh.coords();
+  const auto& nvertices = mesh.nverts();
+  const auto& dim = mesh.dim();
+  const auto cell_centroids = this->cell_centroids;
+
+  // CSR data structure of adjacent cell information of each vertex in a mesh
+  const auto& nodes2faces = mesh.ask_up(VERT, FACE);
+  const auto& n2f_ptr = nodes2faces.a2ab;
+  const auto& n2f_data = nodes2faces.ab2b;
+  const auto& faces2nodes = mesh.ask_down(FACE, VERT).ab2b;
+
+  // set for the targets whose search exceeded the size of the queue or of the
+  // visited set
+  Write<LO> overflowed(nvertices, 0, "support search overflow");
 
   parallel_for(
-      nvertices,  // for each target vertex which is a node for this case
-      OMEGA_H_LAMBDA(const LO id) {
+      targets.size(),  // for each target vertex which is a node for this case
+      OMEGA_H_LAMBDA(const LO target) {
+        const LO id = targets[target];
         queue queue;
         track visited;
         const LO num_verts_in_dim = dim + 1;
@@ -126,7 +156,8 @@ void FindSupports::adjBasedSearch(Write<LO>& supports_ptr, Write<LO>& nSupports,
 
         // loops over the queued cells from the neighborhood of the target
         // vertex
-        while (!queue.isEmpty()) {  // ? can queue be empty?
+        while (!queue.isEmpty() && !queue.overflowed() &&
+               !visited.overflowed()) {  // ? can queue be empty?
           LO currentCell = queue.front();
           queue.pop_front();
           LO start = currentCell *
@@ -174,9 +205,24 @@ void FindSupports::adjBasedSearch(Write<LO>& supports_ptr, Write<LO>& nSupports,
 
         }  // end of while loop
 
+        if (queue.overflowed() || visited.overflowed()) {
+          overflowed[id] = 1;
+        }
         nSupports[id] = count;
       },  // end of lambda
       "count the number of supports in each target point");
+
+  const LO noverflowed = get_sum(Read<LO>(overflowed));
+  // the fill call repeats the same search, so only the count call warns
+  if (noverflowed > 0 && is_build_csr_call) {
+    // the original search also kept the supports found before the lists
+    // were full, so this is not an error
+    fprintf(stderr,
+            "warning: support search of %d targets visited more than %d "
+            "entities or queued more than %d. Only the supports found "
+            "before the limit are used, reduce the cutoff distance\n",
+            noverflowed, MAX_SIZE_TRACK, MAX_SIZE_QUEUE);
+  }
 }
 
 struct SupportResults {
@@ -185,7 +231,7 @@ struct SupportResults {
   Write<Real> radii2;  // squared radii of the supports
 };
 
-SupportResults searchNeighbors(Mesh& mesh, Real cutoffDistance) {
+inline SupportResults searchNeighbors(Mesh& mesh, Real cutoffDistance) {
   LO min_support = 12;
   SupportResults support;
 
@@ -196,67 +242,41 @@ SupportResults searchNeighbors(Mesh& mesh, Real cutoffDistance) {
   Write<LO> nSupports(nvertices_target, 0,
                       "number of supports in each target vertex");
 
-  printf("Inside searchNeighbors 1\n");
   support.radii2 = Write<Real>(nvertices_target, cutoffDistance,
                                "squared radii of the supports");
-  printf("cut off distance: %f\n", cutoffDistance);
-  // this call gets the number of supports for each target vertex: nSupports and
-  // the squared radii of the supports (with might be increased in the search to
-  // have enough supports)
-  int r_adjust_loop = 0;
-  while (true) { // until the number of minimum support is met
-    // find maximum radius
-  Real max_radius = 0.0;
-  Kokkos::parallel_reduce("find max radius",
-      nvertices_target,
-      OMEGA_H_LAMBDA(const LO i, Real& local_max) {
-        local_max = (support.radii2[i] > local_max) ? support.radii2[i] : local_max;
-      },
-      Kokkos::Max<Real>(max_radius));
-  printf("Loop %d: max_radius: %f\n", r_adjust_loop, max_radius);
-  
-  search.adjBasedSearch(support.supports_ptr, nSupports, support.supports_idx,
-                        support.radii2, true);
-
-  //printf("Inside searchNeighbors 2\n");
-  Kokkos::fence();
-  // * find the minimum number of supports
-  LO min_nSupports = 0;
-  Kokkos::parallel_reduce( "find min number of supports",
-      nvertices_target,
-      OMEGA_H_LAMBDA(const LO i, LO& local_min) {
-        local_min = (nSupports[i] < local_min) ? nSupports[i] : local_min;
-      },
-      Kokkos::Min<LO>(min_nSupports));
-
-  printf("min_nSupports: %d at loop %d, max_radius %f\n", min_nSupports, r_adjust_loop, max_radius);
-  r_adjust_loop++;
-
-  if (min_nSupports >= min_support) {
-    break;
-  }
-
-  Kokkos::fence();
-
-  // * update radius if nSupport is less that min_support
-  parallel_for(
-      nvertices_target, OMEGA_H_LAMBDA(const LO i) {
-        if (nSupports[i] < min_support) {
+  // count the supports of every target, then grow the radii of the targets
+  // that have fewer than min_support supports and count only those again
+  // until every target has enough supports. The counts of the other targets
+  // are kept in nSupports
+  Read<LO> targets = LOs(nvertices_target, 0, 1);
+  while (true) {  // until the number of minimum support is met
+    search.adjBasedSearch(support.supports_ptr, nSupports,
+                          support.supports_idx, support.radii2, true,
+                          targets);
+
+    Write<I8> too_few_supports(targets.size(), 0,
+                               "targets with too few supports");
+    parallel_for(
+        targets.size(), OMEGA_H_LAMBDA(const LO i) {
+          too_few_supports[i] = nSupports[targets[i]] < min_support;
+        });
+    targets = unmap(collect_marked(Read<I8>(too_few_supports)), targets, 1);
+    if (targets.size() == 0) {
+      break;
+    }
+
+    // * update radius if nSupport is less that min_support
+    parallel_for(
+        targets.size(), OMEGA_H_LAMBDA(const LO t) {
+          const LO i = targets[t];
           Real factor = Real(min_support) / nSupports[i];
           factor = (nSupports[i] == 0 || factor > 3.0) ? 3.0 : factor;
           support.radii2[i] *= factor;
-          //nSupports[i] = 0;  // ? might not be needed
-        }
-      });
-
+        });
   }
 
-  printf("INFO: Took %d loops to adjust the radius\n", r_adjust_loop);
-
-  search.adjBasedSearch(support.supports_ptr, nSupports, support.supports_idx,
-                        support.radii2, true);
-
-  // offset array for the supports of each target vertex
+  // offset array for the supports of each target vertex built from the counts
+  // of the last search of each target
   support.supports_ptr =
       Write<LO>(nvertices_target + 1, 0,
                 "number of support source vertices in CSR format");
@@ -266,8 +286,7 @@ SupportResults searchNeighbors(Mesh& mesh, Real cutoffDistance) {
   // get the total number of supports and fill the offset array
   Kokkos::parallel_scan(
       nvertices_target,
-      OMEGA_H_LAMBDA(int j, int& update, bool final) {  // what final does?
-        // OMEGA_H_CHECK(nSupports[j] >= 15);
+      OMEGA_H_LAMBDA(int j, int& update, bool final) {
         update += nSupports[j];
         if (final) {
           support.supports_ptr[j + 1] = update;
@@ -275,13 +294,11 @@ SupportResults searchNeighbors(Mesh& mesh, Real cutoffDistance) {
       },
       total_supports);
 
-  printf("Inside searchNeighbors 3\n");
   Kokkos::fence();
 
   support.supports_idx = Write<LO>(
       total_supports, 0, "index of source supports of each target node");
 
-  printf("total_supports: %d\n", total_supports);
   // second call to get the actual support indices
   // now sizes of support.supports_ptr and support.supports_idx are known and >
   // 0
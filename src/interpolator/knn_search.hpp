@@ -0,0 +1,248 @@
+#ifndef KNN_SEARCH_HPP
+#define KNN_SEARCH_HPP
+
+#include <Omega_h_bbox.hpp>
+#include <Omega_h_scan.hpp>
+#include <pcms/uniform_grid.h>
+
+#include <algorithm>
+#include <limits>
+
+#include "adj_search_dega2.hpp"
+
+// largest number of nearest neighbors that can be found for each target
+static constexpr int max_knn = 64;
+// the radius of each target is its distance to the k-th support scaled by
+// this factor, so the k-th support and supports tied with it are inside the
+// radial basis function
+static constexpr Real knn_radius_scale = 1.1;
+
+// source points sorted into the cells of a uniform grid in CSR form
+template <int dim>
+struct BinnedPoints {
+  pcms::BasicUniformGrid<dim> grid;
+  LOs cell_ptr;
+  Write<LO> cell_points;
+};
+
+// bin the points into a grid that has about points_per_cell points per cell
+template <int dim>
+BinnedPoints<dim> binPoints(const Reals coordinates, LO points_per_cell) {
+  const LO npoints = coordinates.size() / dim;
+  const auto bbox = find_bounding_box<dim>(coordinates);
+
+  BinnedPoints<dim> binned;
+  std::array<Real, dim> lengths;
+  for (int k = 0; k < dim; ++k) {
+    lengths[k] = bbox.max[k] - bbox.min[k];
+    binned.grid.edge_length[k] = lengths[k];
+    binned.grid.bot_left[k] = bbox.min[k];
+  }
+  const LO ncells_requested =
+      (npoints / points_per_cell > 1) ? npoints / points_per_cell : 1;
+  binned.grid.divisions =
+      pcms::automatic_grid_divisions<dim>(lengths, ncells_requested);
+  const LO ncells = binned.grid.GetNumCells();
+  const auto grid = binned.grid;
+
+  Write<LO> point_cells(npoints, "grid cell of each point");
+  Write<LO> cell_counts(ncells, 0, "number of points in each grid cell");
+  parallel_for(
+      npoints, OMEGA_H_LAMBDA(const LO i) {
+        Vector<dim> point;
+        for (int k = 0; k < dim; ++k) {
+          point[k] = coordinates[i * dim + k];
+        }
+        const LO cell = grid.ClosestCellID(point);
+        point_cells[i] = cell;
+        Kokkos::atomic_increment(&cell_counts[cell]);
+      });
+  binned.cell_ptr = offset_scan(Read<LO>(cell_counts));
+
+  const auto cell_ptr = binned.cell_ptr;
+  Write<LO> cell_fill(ncells, 0, "number of points placed in each grid cell");
+  Write<LO> cell_points(npoints, "points of each grid cell");
+  parallel_for(
+      npoints, OMEGA_H_LAMBDA(const LO i) {
+        const LO cell = point_cells[i];
+        const LO position =
+            cell_ptr[cell] + Kokkos::atomic_fetch_add(&cell_fill[cell], 1);
+        cell_points[position] = i;
+      });
+  binned.cell_points = cell_points;
+  return binned;
+}
+
+// the supports of each target are its k closest source points sorted by
+// distance. The rings of grid cells around the cell of the target are
+// searched until the k-th closest point found is closer than any cell that
+// has not been searched. The radius of each target is knn_radius_scale times
+// the distance to its k-th support, and at least a small fraction of the
+// size of the sources, so a target that coincides with all of its supports
+// does not get a zero radius. Unlike searchNeighbors, this needs no mesh
+// adjacency and no radius adaptation
+template <int dim>
+SupportResults searchKNearestNeighbors(const Reals source_coordinates,
+                                       const Reals target_coordinates, LO k) {
+  const LO nsources = source_coordinates.size() / dim;
+  const LO ntargets = target_coordinates.size() / dim;
+  OMEGA_H_CHECK(nsources > 0);
+  OMEGA_H_CHECK(k > 0 && k <= max_knn);
+  k = (k < nsources) ? k : nsources;
+
+  const auto binned = binPoints<dim>(source_coordinates, k);
+  const auto grid = binned.grid;
+  Real diagonal2 = 0;
+  for (int d = 0; d < dim; ++d) {
+    diagonal2 += grid.edge_length[d] * grid.edge_length[d];
+  }
+  const Real min_radius2 =
+      std::max(1e-12 * diagonal2, std::numeric_limits<Real>::min());
+  const auto cell_ptr = binned.cell_ptr;
+  const auto cell_points = binned.cell_points;
+
+  SupportResults support;
+  support.supports_ptr =
+      Write<LO>(ntargets + 1, 0, k, "number of supports in CSR format");
+  support.supports_idx =
+      Write<LO>(ntargets * k, "index of source supports of each target node");
+  support.radii2 = Write<Real>(ntargets, "squared radii of the supports");
+  const auto supports_idx = support.supports_idx;
+  const auto radii2 = support.radii2;
+
+  parallel_for(
+      ntargets,
+      OMEGA_H_LAMBDA(const LO t) {
+        Real target_coords[dim];
+        Vector<dim> target_point;
+        for (int d = 0; d < dim; ++d) {
+          target_coords[d] = target_coordinates[t * dim + d];
+          target_point[d] = target_coords[d];
+        }
+        // the k closest points found so far, sorted by distance
+        Real nearest_dist2[max_knn];
+        LO nearest[max_knn];
+        LO nfound = 0;
+
+        // cell of the target and the grid size in coordinate order
+        const auto center_index =
+            grid.GetDimensionedIndex(grid.ClosestCellID(target_point));
+        LO center[dim];
+        LO ring_to_cover_grid = 0;
+        for (int d = 0; d < dim; ++d) {
+          center[d] = center_index[dim - (d + 1)];
+          const LO low = center[d];
+          const LO high = grid.divisions[d] - 1 - center[d];
+          ring_to_cover_grid = (low > ring_to_cover_grid) ? low
+                                                          : ring_to_cover_grid;
+          ring_to_cover_grid =
+              (high > ring_to_cover_grid) ? high : ring_to_cover_grid;
+        }
+
+        for (LO ring = 0; ring <= ring_to_cover_grid; ++ring) {
+          // odometer over the cube of cells around the center cell clamped
+          // to the grid. Only the cells on the surface of the cube are new
+          LO lower[dim];
+          LO upper[dim];
+          LO cell_index[dim];
+          for (int d = 0; d < dim; ++d) {
+            lower[d] = (center[d] - ring > 0) ? center[d] - ring : 0;
+            upper[d] = (center[d] + ring < grid.divisions[d] - 1)
+                           ? center[d] + ring
+                           : grid.divisions[d] - 1;
+            cell_index[d] = lower[d];
+          }
+          while (true) {
+            bool on_surface = false;
+            std::array<LO, dim> dimensioned_index;
+            for (int d = 0; d < dim; ++d) {
+              on_surface = on_surface || cell_index[d] == center[d] - ring ||
+                           cell_index[d] == center[d] + ring;
+              dimensioned_index[dim - (d + 1)] = cell_index[d];
+            }
+            if (on_surface) {
+              const LO cell = grid.GetCellIndex(dimensioned_index);
+              for (LO p = cell_ptr[cell]; p < cell_ptr[cell + 1]; ++p) {
+                const LO source = cell_points[p];
+                Real dist2 = 0;
+                for (int d = 0; d < dim; ++d) {
+                  const Real dx =
+                      source_coordinates[source * dim + d] - target_coords[d];
+                  dist2 += dx * dx;
+                }
+                if (nfound < k || dist2 < nearest_dist2[k - 1]) {
+                  LO position = (nfound < k) ? nfound++ : k - 1;
+                  while (position > 0 && nearest_dist2[position - 1] > dist2) {
+                    nearest_dist2[position] = nearest_dist2[position - 1];
+                    nearest[position] = nearest[position - 1];
+                    --position;
+                  }
+                  nearest_dist2[position] = dist2;
+                  nearest[position] = source;
+                }
+              }
+            }
+            int d = 0;
+            for (; d < dim; ++d) {
+              if (++cell_index[d] <= upper[d]) {
+                break;
+              }
+              cell_index[d] = lower[d];
+            }
+            if (d == dim) {
+              break;
+            }
+          }
+          if (nfound < k) {
+            continue;
+          }
+          // distance from the target to the closest cell that has not been
+          // searched
+          Real unsearched_distance = ArithTraits<Real>::max();
+          for (int d = 0; d < dim; ++d) {
+            const Real cell_width = grid.edge_length[d] / grid.divisions[d];
+            if (center[d] - ring > 0) {
+              const Real gap = target_coords[d] -
+                               (grid.bot_left[d] +
+                                (center[d] - ring) * cell_width);
+              unsearched_distance =
+                  (gap < unsearched_distance) ? gap : unsearched_distance;
+            }
+            if (center[d] + ring < grid.divisions[d] - 1) {
+              const Real gap = grid.bot_left[d] +
+                               (center[d] + ring + 1) * cell_width -
+                               target_coords[d];
+              unsearched_distance =
+                  (gap < unsearched_distance) ? gap : unsearched_distance;
+            }
+          }
+          if (unsearched_distance * unsearched_distance >=
+              nearest_dist2[k - 1]) {
+            break;
+          }
+        }
+
+        for (LO j = 0; j < k; ++j) {
+          supports_idx[t * k + j] = nearest[j];
+        }
+        const Real radius2 =
+            knn_radius_scale * knn_radius_scale * nearest_dist2[k - 1];
+        radii2[t] = (radius2 > min_radius2) ? radius2 : min_radius2;
+      },
+      "k nearest neighbor supports");
+
+  return support;
+}
+
+inline SupportResults searchKNearestNeighbors(const Reals source_coordinates,
+                                              const Reals target_coordinates,
+                                              LO k, LO dim) {
+  OMEGA_H_CHECK(dim == 2 || dim == 3);
+  if (dim == 2) {
+    return searchKNearestNeighbors<2>(source_coordinates, target_coordinates,
+                                      k);
+  }
+  return searchKNearestNeighbors<3>(source_coordinates, target_coordinates, k);
+}
+
+#endif
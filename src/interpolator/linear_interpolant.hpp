@@ -3,170 +3,246 @@
 #define INTERPOLANT_HPP 
 
 
-#include <iostream>
+#include <array>
+#include <cmath>
+#include <stdexcept>
 #include "multidimarray.hpp"
-#define MAX_DIM 10
-
-
-KOKKOS_INLINE_FUNCTION
-void find_indices(const IntVecView& num_bins,  const RealVecView& range,
-    const RealVecView& point , int* indices){
-    int dim = point.extent(0);
-   // IntVecView indices("parametric coordinate", dim);
-    for (int i = 0; i < dim; ++i){
-        int id = i * 2;
-        double length = range(id + 1) - range(id);
-        double dlen = length/num_bins(i);
-        indices[i] = ((point(i) - range(id)) / dlen);
-        
-    }
-
-
-}
-
-
-KOKKOS_INLINE_FUNCTION
-void find_limits(const IntVecView& num_bins,  const RealVecView& range, const int* indices, double* limits){
-    int dim = num_bins.extent(0);
-   // RealVecView limits("limits", 2*dim);
-    for (int i = 0; i < dim; ++i){
-	int ptr = i * 2;
-	double dlen = (range(ptr+1) - range(ptr))/num_bins(i);
-	limits[ptr] = indices[i] * dlen;
-	limits[ptr+1] = limits[ptr] + dlen;
-    }
-}
-
-
-
-KOKKOS_INLINE_FUNCTION
-void evaluateParametricCoord(const RealVecView& point, const double* limits , double* parametric_coord){
-     int dim = point.extent(0);
-   //  RealVecView parametric_coord("parametric coordinate", dim);
-     for (int i = 0; i < dim; ++i){
-        int index = i * 2;
-        parametric_coord[i] = (point(i) - limits[index])/(limits[index+1] - limits[index]);
-
-     }
-}
-
-
-
-KOKKOS_INLINE_FUNCTION
-void basis_function(const RealVecView& parametric_coord, double* linear_basis_each_dir){
-    int dim = parametric_coord.extent(0);
-   // RealVecView linear_basis_each_dir("basis function each direction", 2*dim);
-    for (int i = 0; i < dim; ++i){
-        int index = i * 2;
-        
-        linear_basis_each_dir[index] =  1 - parametric_coord(i);
-        
-        linear_basis_each_dir[index + 1] =  parametric_coord(i);
-
-
-    }
-
-}
-
-
-KOKKOS_INLINE_FUNCTION
-double linear_interpolant(const IntVecView& dimensions, const double* linear_basis_each_dir, const IntVecView& indices, const RealVecView& values){ 
-    int dim = dimensions.extent(0);    
-    double sum = 0; 
-    int ids[MAX_DIM];
-    
-    int array_size = 1 << dim;
-    for (int i = 0; i < array_size; ++i){ 
-       	double temp = 1.0; 
-        for (int j = 0; j < dim; ++j){ 
-            int index = 2*j;
-            int id_left = indices(j);
-            int id_right = id_left + 1;
-            if (i & (1 << j)){
-                temp *= linear_basis_each_dir[index+1];
-                ids[j] = id_right;
-            } else {
-                temp *= linear_basis_each_dir[index];
-                ids[j] = id_left;
-            }
-        }
-      
-	int idx = calculateIndex(dimensions, ids);  
-        double corner_values = values(idx);
-
-        sum += temp*corner_values;
-    }
-    return sum;
-}
 
 
+enum class InterpolationOrder { Linear = 1, Cubic = 3 };
 
+// interpolation of values given at the nodes of a regular grid in dim
+// dimensions. Direction d has num_bins[d] cells and num_bins[d] + 1 nodes
+// over [lower[d], upper[d]]. The node values are stored row major with the
+// last direction varying fastest, i.e. as calculateIndex numbers them. The
+// cubic order is Catmull-Rom interpolation, which uses linearly extrapolated
+// nodes outside of the grid so that linear functions are reproduced exactly
+template <int dim, InterpolationOrder order = InterpolationOrder::Linear>
 class RegularGridInterpolator {
-    private:
-        const RealMatView parametric_coords;
-        const RealVecView values;
-        const IntMatView indices;
-	const IntVecView dimensions;
-
     public:
-        RegularGridInterpolator(const RealMatView& parametric_coords_, 
-                            const RealVecView& values_, const IntMatView& indices_, const IntVecView& dimensions_) 
-                            : parametric_coords(parametric_coords_), values(values_), indices(indices_), dimensions(dimensions_) {};
-   
-RealVecView linear_interpolation() {
-	    int dim = dimensions.extent(0);
-	    int N = parametric_coords.extent(0);
-	    RealVecView interpolated_values("approximated values", N);
-	    auto parametric_coords_ = parametric_coords;
-	    auto dimensions_ = dimensions;
-	    auto values_ = values;
-	    auto indices_ = indices;
-	    Kokkos::parallel_for("linear interpolation function",N, KOKKOS_LAMBDA(int j){
-		double linear_basis_each_dir[MAX_DIM] = {0.0};
-    		auto parametric_coord_each_point = Kokkos::subview(parametric_coords_, j, Kokkos::ALL());
- 		auto index_each_point = Kokkos::subview(indices_, j , Kokkos::ALL());
-                basis_function(parametric_coord_each_point, linear_basis_each_dir);
-		auto approx_value =  linear_interpolant(dimensions_, linear_basis_each_dir,index_each_point, values_);
-		interpolated_values(j) = approx_value;     
+	// number of nodes of the stencil in each direction
+	static constexpr int stencil_size =
+	    (order == InterpolationOrder::Linear) ? 2 : 4;
+
+        RegularGridInterpolator(const std::array<int, dim>& num_bins,
+                                const std::array<double, dim>& lower,
+                                const std::array<double, dim>& upper)
+            : num_bins_(num_bins), lower_(lower) {
+	    const int min_bins = (order == InterpolationOrder::Linear) ? 1 : 3;
+	    for (int d = dim - 1; d >= 0; --d) {
+		if (num_bins_[d] < min_bins) {
+		    throw std::invalid_argument(
+			"RegularGridInterpolator needs more grid cells");
+		}
+		cell_width_[d] = (upper[d] - lower[d]) / num_bins_[d];
+		strides_[d] =
+		    (d == dim - 1) ? 1 : strides_[d + 1] * (num_bins_[d + 1] + 1);
+	    }
+	}
+
+	[[nodiscard]] int num_nodes() const {
+	    return strides_[0] * (num_bins_[0] + 1);
+	}
+
+	// interpolate several fields at the points. values has one row per grid
+	// node and one column per field and the result has one row per point. The
+	// stencil of each point is computed once for all of the fields
+	RealMatView evaluate(const RealMatView& points,
+	                     const RealMatView& values) const {
+	    RealMatView interpolated_values("approximated values",
+	                                    points.extent(0), values.extent(1));
+	    interpolate(points, values, interpolated_values);
+	    return interpolated_values;
+	}
+
+	RealVecView evaluate(const RealMatView& points,
+	                     const RealVecView& values) const {
+	    using UnmanagedMatView =
+	        Kokkos::View<double**, Kokkos::LayoutRight,
+	                     Kokkos::MemoryTraits<Kokkos::Unmanaged>>;
+	    RealVecView interpolated_values("approximated values",
+	                                    points.extent(0));
+	    interpolate(points, UnmanagedMatView(values.data(), values.extent(0), 1),
+	                UnmanagedMatView(interpolated_values.data(),
+	                                 interpolated_values.extent(0), 1));
+	    return interpolated_values;
+	}
+
+	// interpolates values into interpolated_values, which both have one column
+	// per field. This is public because CUDA does not allow device lambdas in
+	// private member functions
+	template <typename ValueView, typename ResultView>
+	void interpolate(const RealMatView& points, const ValueView& values,
+	                 const ResultView& interpolated_values) const {
+	    if (static_cast<int>(points.extent(1)) != dim ||
+	        static_cast<int>(values.extent(0)) != num_nodes()) {
+		throw std::invalid_argument(
+		    "RegularGridInterpolator points or values have the wrong size");
+	    }
+	    const int N = points.extent(0);
+	    const int nfields = values.extent(1);
+	    const auto num_bins = num_bins_;
+	    const auto lower = lower_;
+	    const auto cell_width = cell_width_;
+	    const auto strides = strides_;
+	    Kokkos::parallel_for("regular grid interpolation", N,
+	        KOKKOS_LAMBDA(int j) {
+		int start[dim];
+		double weights[dim][stencil_size];
+		for (int d = 0; d < dim; ++d) {
+		    start[d] = stencil(points(j, d), lower[d], cell_width[d],
+		                       num_bins[d], weights[d]);
+		}
+		for (int f = 0; f < nfields; ++f) {
+		    interpolated_values(j, f) = 0;
+		}
+		int ncorners = 1;
+		for (int d = 0; d < dim; ++d) {
+		    ncorners *= stencil_size;
+		}
+		for (int corner = 0; corner < ncorners; ++corner) {
+		    int remainder = corner;
+		    int node = 0;
+		    double weight = 1.0;
+		    for (int d = dim - 1; d >= 0; --d) {
+			const int k = remainder % stencil_size;
+			remainder /= stencil_size;
+			weight *= weights[d][k];
+			node += (start[d] + k) * strides[d];
+		    }
+		    if (weight == 0.0) {
+			continue;
+		    }
+		    for (int f = 0; f < nfields; ++f) {
+			interpolated_values(j, f) += weight * values(node, f);
+		    }
+		}
 	    });
+	}
 
-	    return interpolated_values;
-	}	    
+    private:
+	// first node of the stencil of coordinate x in one direction and the
+	// weights of the stencil nodes
+	KOKKOS_INLINE_FUNCTION
+	static int stencil(double x, double lower, double cell_width, int num_bins,
+	                   double* weights) {
+	    const double position = (x - lower) / cell_width;
+	    int cell = static_cast<int>(floor(position));
+	    cell = (cell < 0) ? 0 : ((cell > num_bins - 1) ? num_bins - 1 : cell);
+	    const double t = position - cell;
+	    if constexpr (order == InterpolationOrder::Linear) {
+		weights[0] = 1 - t;
+		weights[1] = t;
+		return cell;
+	    } else {
+		double w[4];
+		w[0] = ((-0.5 * t + 1.0) * t - 0.5) * t;
+		w[1] = (1.5 * t - 2.5) * t * t + 1.0;
+		w[2] = ((-1.5 * t + 2.0) * t + 0.5) * t;
+		w[3] = (0.5 * t - 0.5) * t * t;
+		if (cell == 0) {
+		    // node -1 is extrapolated as 2 f(0) - f(1)
+		    weights[0] = w[1] + 2 * w[0];
+		    weights[1] = w[2] - w[0];
+		    weights[2] = w[3];
+		    weights[3] = 0;
+		    return 0;
+		}
+		if (cell == num_bins - 1) {
+		    // node num_bins + 1 is extrapolated as 2 f(n) - f(n-1)
+		    weights[0] = 0;
+		    weights[1] = w[0];
+		    weights[2] = w[1] - w[3];
+		    weights[3] = w[2] + 2 * w[3];
+		    return cell - 2;
+		}
+		for (int k = 0; k < 4; ++k) {
+		    weights[k] = w[k];
+		}
+		return cell - 1;
+	    }
+	}
+
+	std::array<int, dim> num_bins_;
+	std::array<double, dim> lower_;
+	std::array<double, dim> cell_width_;
+	std::array<int, dim> strides_;
 };
 
+// largest dimension of the grids of parametric_indices and
+// linear_interpolation
+static constexpr int max_grid_dim = 10;
 
 struct Result{
     IntMatView indices_pts;
     RealMatView parametric_coords;
-};    
+};
 
-Result parametric_indices(const RealMatView& points, const IntVecView& num_bins, const RealVecView& range){
-    
-    int dim = num_bins.extent(0);
+// cell of each point and the parametric coordinates of the point in the cell
+// for a grid with num_bins cells in each direction over the range
+// [lower_0, upper_0, lower_1, upper_1, ...]. Points outside of the grid get
+// the closest cell. RegularGridInterpolator computes the same stencils on the
+// fly
+inline Result parametric_indices(const RealMatView& points,
+                                 const IntVecView& num_bins,
+                                 const RealVecView& range) {
+    const int dim = num_bins.extent(0);
+    const int N = points.extent(0);
     Result result;
-    int N = points.extent(0);
-    result.indices_pts = IntMatView("indices",N,dim);
-    result.parametric_coords = RealMatView("parametric_coordinates",N, dim);
-
-    Kokkos::parallel_for(N, KOKKOS_LAMBDA(int j){
-	int indcs[MAX_DIM] = {0};
-	double limits[MAX_DIM] = {0.0};
-	double parametric_coord_each[MAX_DIM] = {0.0};
-	auto point_coord = Kokkos::subview(points, j , Kokkos::ALL());
-	find_indices(num_bins, range, point_coord, indcs);
-	find_limits(num_bins, range, indcs, limits);
-	evaluateParametricCoord( point_coord, limits, parametric_coord_each);
-	for (int i = 0; i < dim; ++i){
-	    result.indices_pts(j,i) = indcs[i];
-	    result.parametric_coords(j,i) = parametric_coord_each[i]; 
-	}	
-
+    result.indices_pts = IntMatView("indices", N, dim);
+    result.parametric_coords = RealMatView("parametric_coordinates", N, dim);
+    const auto indices = result.indices_pts;
+    const auto parametric_coords = result.parametric_coords;
+    Kokkos::parallel_for("parametric indices", N, KOKKOS_LAMBDA(int j) {
+	for (int i = 0; i < dim; ++i) {
+	    const double lower = range(2 * i);
+	    const double cell_width = (range(2 * i + 1) - lower) / num_bins(i);
+	    const double position = (points(j, i) - lower) / cell_width;
+	    int cell = static_cast<int>(floor(position));
+	    cell = (cell < 0) ? 0
+	                      : ((cell > num_bins(i) - 1) ? num_bins(i) - 1 : cell);
+	    indices(j, i) = cell;
+	    parametric_coords(j, i) = position - cell;
+	}
     });
-
     return result;
-    
 }
 
+// multilinear interpolation of the values at the nodes of a grid with
+// dimensions nodes in each direction from the cells and parametric
+// coordinates of parametric_indices. This is the same as
+// RegularGridInterpolator with InterpolationOrder::Linear
+inline RealVecView linear_interpolation(const RealMatView& parametric_coords,
+                                        const RealVecView& values,
+                                        const IntMatView& indices,
+                                        const IntVecView& dimensions) {
+    const int dim = dimensions.extent(0);
+    if (dim > max_grid_dim) {
+	throw std::invalid_argument(
+	    "linear_interpolation grid has more than max_grid_dim dimensions");
+    }
+    const int N = parametric_coords.extent(0);
+    RealVecView interpolated_values("approximated values", N);
+    Kokkos::parallel_for("linear interpolation function", N,
+        KOKKOS_LAMBDA(int j) {
+	int ids[max_grid_dim];
+	double sum = 0;
+	for (int corner = 0; corner < (1 << dim); ++corner) {
+	    double weight = 1.0;
+	    for (int i = 0; i < dim; ++i) {
+		const double t = parametric_coords(j, i);
+		const bool upper = corner & (1 << i);
+		weight *= upper ? t : 1 - t;
+		ids[i] = indices(j, i) + (upper ? 1 : 0);
+	    }
+	    sum += weight * values(calculateIndex(dimensions, ids));
+	}
+	interpolated_values(j) = sum;
+    });
+    return interpolated_values;
+}
+
+
 KOKKOS_INLINE_FUNCTION
 double test_function(double* coord){
     double fun_value = 0;
@@ -178,6 +254,3 @@ double test_function(double* coord){
     }
 
 #endif
-
-
-
@@ -25,7 +25,7 @@ int calculateIndex(const IntVecView& dimensions, const int* indices) {
 }
 
 
-int calculateTotalSize(const HostIntVecView& dimensions){
+inline int calculateTotalSize(const HostIntVecView& dimensions){
    int dim = dimensions.extent(0);
    int size = 1;
    for (int i = 0; i < dim; ++i){
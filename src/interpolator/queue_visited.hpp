@@ -2,20 +2,37 @@
 #define QUEUE_VISITED_HPP
 
 #include <Omega_h_build.hpp>
+#include <Omega_h_fail.hpp>
 #include <Omega_h_file.hpp>
 #include <Omega_h_for.hpp>
 #include <Omega_h_library.hpp>
 #include <Omega_h_mesh.hpp>
 #include <Omega_h_reduce.hpp>
-#define MAX_SIZE_QUEUE 500
-#define MAX_SIZE_TRACK 800
-using namespace std;
+#include <cstdint>
+// maximum number of entries of the queue and of the visited set. They are at
+// least the 500 and 800 entries of the original lists, so every search that
+// fit in those still fits. The queue is a ring buffer that only holds the
+// supports that have not been expanded yet, so it needs fewer entries than
+// the visited set
+#define MAX_SIZE_QUEUE 512
+#define MAX_SIZE_TRACK 1024
+// number of hash slots of the visited set. A power of two at least twice
+// MAX_SIZE_TRACK keeps the probe sequences short
+#define HASH_SIZE_TRACK 2048
 using namespace Omega_h;
 
+static_assert((HASH_SIZE_TRACK & (HASH_SIZE_TRACK - 1)) == 0,
+              "the visited set size must be a power of two");
+static_assert(HASH_SIZE_TRACK >= 2 * MAX_SIZE_TRACK,
+              "the visited set must be at most half full");
+
+// fixed size FIFO queue. Pushing onto a full queue drops the item and marks
+// the queue as overflowed
 class queue {
  private:
   LO queue_array[MAX_SIZE_QUEUE];
   int first = 0, last = -1, count = 0;
+  bool overflow = false;
 
  public:
   OMEGA_H_INLINE
@@ -38,16 +55,34 @@ class queue {
 
   OMEGA_H_INLINE
   bool isFull() const;
+
+  OMEGA_H_INLINE
+  bool overflowed() const { return overflow; }
 };
 
+// set of visited (non-negative) ids as an open addressing hash table with
+// linear probing, so lookups take constant time. Inserting into a full set
+// drops the item and marks the set as overflowed
 class track {
  private:
-  LO tracking_array[MAX_SIZE_TRACK];
-  int first = 0, last = -1, count = 0;
+  LO tracking_array[HASH_SIZE_TRACK];
+  int count = 0;
+  bool overflow = false;
+
+  OMEGA_H_INLINE
+  static int hash(const int& item) {
+    // Fibonacci hashing spreads consecutive ids over the table
+    return static_cast<int>((static_cast<std::uint32_t>(item) * 2654435769u) &
+                            (HASH_SIZE_TRACK - 1));
+  }
 
  public:
   OMEGA_H_INLINE
-  track() {}
+  track() {
+    for (int i = 0; i < HASH_SIZE_TRACK; ++i) {
+      tracking_array[i] = -1;
+    }
+  }
 
   OMEGA_H_INLINE
   ~track() {}
@@ -60,12 +95,15 @@ class track {
 
   OMEGA_H_INLINE
   bool notVisited(const int& item);
+
+  OMEGA_H_INLINE
+  bool overflowed() const { return overflow; }
 };
 
 OMEGA_H_INLINE
 void queue::push_back(const int& item) {
   if (count == MAX_SIZE_QUEUE) {
-    printf("queue is full %d\n", count);
+    overflow = true;
     return;
   }
   last = (last + 1) % MAX_SIZE_QUEUE;
@@ -75,10 +113,7 @@ void queue::push_back(const int& item) {
 
 OMEGA_H_INLINE
 void queue::pop_front() {
-  if (count == 0) {
-    printf("queue is empty\n");
-    return;
-  }
+  OMEGA_H_CHECK(count > 0);
   first = (first + 1) % MAX_SIZE_QUEUE;
   count--;
 }
@@ -94,23 +129,31 @@ bool queue::isFull() const { return count == MAX_SIZE_QUEUE; }
 
 OMEGA_H_INLINE
 void track::push_back(const int& item) {
+  OMEGA_H_CHECK(item >= 0);
+  int id = hash(item);
+  while (tracking_array[id] != -1) {
+    if (tracking_array[id] == item) {
+      return;
+    }
+    id = (id + 1) & (HASH_SIZE_TRACK - 1);
+  }
   if (count == MAX_SIZE_TRACK) {
-    printf("track is full %d\n", count);
+    overflow = true;
     return;
   }
-  last = (last + 1) % MAX_SIZE_TRACK;
-  tracking_array[last] = item;
+  tracking_array[id] = item;
   count++;
 }
 
 OMEGA_H_INLINE
 bool track::notVisited(const int& item) {
-  int id;
-  for (int i = 0; i < count; ++i) {
-    id = (first + i) % MAX_SIZE_TRACK;
+  // the table is never more than half full, so an empty slot ends the probe
+  int id = hash(item);
+  while (tracking_array[id] != -1) {
     if (tracking_array[id] == item) {
       return false;
     }
+    id = (id + 1) & (HASH_SIZE_TRACK - 1);
   }
   return true;
 }
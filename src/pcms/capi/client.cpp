@@ -41,15 +41,23 @@ PcmsReverseClassificationHandle* pcms_load_reverse_classification(
   const char* file, MPI_Comm comm)
 {
   //std::filesystem::path filepath{file};
-  auto* rc = new pcms::ReverseClassificationVertex{
-    pcms::ReadReverseClassificationVertex(file, comm)};
+  // store the flat form so that every field adapter created from this
+  // handle shares the same storage
+  auto* rc = new pcms::ReverseClassificationVertexCSR<>{
+    pcms::ReadReverseClassificationVertexCSR(file, comm)};
   return reinterpret_cast<PcmsReverseClassificationHandle*>(rc);
 }
 void pcms_destroy_reverse_classification(
   PcmsReverseClassificationHandle* rc)
 {
-  if (rc != nullptr)
-    delete reinterpret_cast<pcms::ReverseClassificationVertex*>(rc);
+  if (rc != nullptr) {
+    auto* reverse_classification =
+      reinterpret_cast<pcms::ReverseClassificationVertexCSR<>*>(rc);
+    // the field adapters hold copies of the reverse classification that may
+    // be destroyed in any order, so the shared storage is released here
+    pcms::FreeReverseClassificationVertexCSR(*reverse_classification);
+    delete reverse_classification;
+  }
 }
 
 struct AddFieldVariantOperators {
@@ -120,7 +128,7 @@ void pcms_receive_field(PcmsFieldHandle* field_handle)
 template <typename T>
 void pcms_create_xgc_field_adapter_t(
   const char* name, MPI_Comm comm, void* data, int size,
-  const pcms::ReverseClassificationVertex& reverse_classification,
+  const pcms::ReverseClassificationVertexCSR<>& reverse_classification,
   in_overlap_function in_overlap, pcms::FieldAdapterVariant& field_adapter)
 {
   PCMS_ALWAYS_ASSERT((size >0) ? (data!=nullptr) : true);
@@ -136,7 +144,7 @@ PcmsFieldAdapterHandle* pcms_create_xgc_field_adapter(
   auto* field_adapter = new pcms::FieldAdapterVariant{};
   PCMS_ALWAYS_ASSERT(rc != nullptr);
   auto* reverse_classification =
-    reinterpret_cast<const pcms::ReverseClassificationVertex*>(rc);
+    reinterpret_cast<const pcms::ReverseClassificationVertexCSR<>*>(rc);
   PCMS_ALWAYS_ASSERT(reverse_classification != nullptr);
   switch (data_type) {
     case PCMS_DOUBLE:
@@ -179,13 +187,9 @@ int pcms_reverse_classification_count_verts(
   PcmsReverseClassificationHandle* rc)
 {
   auto* reverse_classification =
-    reinterpret_cast<const pcms::ReverseClassificationVertex*>(rc);
+    reinterpret_cast<const pcms::ReverseClassificationVertexCSR<>*>(rc);
   PCMS_ALWAYS_ASSERT(reverse_classification != nullptr);
-  return std::accumulate(reverse_classification->begin(),
-                         reverse_classification->end(), 0,
-                         [](auto current, const auto& verts) {
-                           return current + verts.second.size();
-                         });
+  return reverse_classification->GetTotalVerts();
 }
 void pcms_begin_send_phase(PcmsClientHandle* h) {
   auto* client = reinterpret_cast<pcms::CouplerClient*>(h);
@@ -40,6 +40,9 @@ void pcms_destroy_client(PcmsClientHandle*);
 // returns a pointer to a handle to a reverse classification object
 PcmsReverseClassificationHandle* pcms_load_reverse_classification(
   const char* file, MPI_Comm comm);
+// collective over the comm used to load the reverse classification. Field
+// adapters created from the handle must not be used afterwards, but they may
+// be destroyed before or after
 void pcms_destroy_reverse_classification(PcmsReverseClassificationHandle*);
 
 // this function is helpful for test cases so we can compute the total number of
@@ -0,0 +1,322 @@
+#include "pcms/distributed_point_search.h"
+#include "pcms/assert.h"
+#include "pcms/profile.h"
+#include <Omega_h_bbox.hpp>
+#include <Omega_h_mesh.hpp>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <numeric>
+
+namespace pcms
+{
+namespace
+{
+bool within_bounds(const Real* point, const AABBox<2>& bounds)
+{
+  for (int i = 0; i < 2; ++i) {
+    // include points on the boundary up to round off
+    const Real tolerance = 1E-10 * bounds.half_width[i];
+    if (!(std::abs(point[i] - bounds.center[i]) <=
+          bounds.half_width[i] + tolerance)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// squared distance from the point to the closest point of the bounds
+Real distance_squared_to_bounds(const Real* point, const AABBox<2>& bounds)
+{
+  Real distance_squared = 0;
+  for (int i = 0; i < 2; ++i) {
+    const Real d = std::max(
+      std::abs(point[i] - bounds.center[i]) - bounds.half_width[i], Real{0});
+    distance_squared += d * d;
+  }
+  return distance_squared;
+}
+
+/// the best evaluation of each point found so far
+struct PointEvaluations
+{
+  // ncomponents values per point
+  std::vector<Real> values;
+  // squared distance from the point to the element it was evaluated on.
+  // Zero if the point is inside of the element
+  std::vector<Real> distances_squared;
+  // rank that evaluated the point
+  std::vector<int> ranks;
+};
+
+using RemoteEvaluation =
+  std::function<void(const std::vector<Real>& points, std::vector<Real>& values,
+                     std::vector<Real>& distances_squared)>;
+using SendPredicate = std::function<bool(std::size_t point, int rank)>;
+
+/**
+ * Send each point to the other ranks selected by send, evaluate the received
+ * points with evaluate and send the values back. A reply replaces the current
+ * evaluation of the point if it is closer, or equally close and from a lower
+ * rank, so points inside of several partitions take the values of the lowest
+ * of those ranks.
+ */
+void exchange_points(MPI_Comm comm, const std::vector<Real>& points,
+                     int ncomponents, const SendPredicate& send,
+                     const RemoteEvaluation& evaluate, PointEvaluations& best)
+{
+  PCMS_FUNCTION_TIMER;
+  int rank = -1;
+  int nranks = 0;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nranks);
+  const std::size_t npoints = best.ranks.size();
+  std::vector<std::vector<LO>> requests(nranks);
+  for (std::size_t p = 0; p < npoints; ++p) {
+    for (int r = 0; r < nranks; ++r) {
+      if (r != rank && send(p, r)) {
+        requests[r].push_back(p);
+      }
+    }
+  }
+  std::vector<int> send_counts(nranks);
+  std::vector<int> recv_counts(nranks);
+  for (int r = 0; r < nranks; ++r) {
+    send_counts[r] = requests[r].size();
+  }
+  MPI_Alltoall(send_counts.data(), 1, MPI_INT, recv_counts.data(), 1, MPI_INT,
+               comm);
+  std::vector<int> send_offsets(nranks + 1, 0);
+  std::vector<int> recv_offsets(nranks + 1, 0);
+  std::partial_sum(send_counts.begin(), send_counts.end(),
+                   send_offsets.begin() + 1);
+  std::partial_sum(recv_counts.begin(), recv_counts.end(),
+                   recv_offsets.begin() + 1);
+  // counts and offsets of messages with the given number of entries per point
+  auto scaled = [](const std::vector<int>& v, int n) {
+    std::vector<int> result(v.size());
+    std::transform(v.begin(), v.end(), result.begin(),
+                   [n](int x) { return x * n; });
+    return result;
+  };
+  std::vector<Real> send_points(2 * send_offsets[nranks]);
+  for (int r = 0; r < nranks; ++r) {
+    for (std::size_t k = 0; k < requests[r].size(); ++k) {
+      const auto p = requests[r][k];
+      send_points[2 * (send_offsets[r] + k)] = points[2 * p];
+      send_points[2 * (send_offsets[r] + k) + 1] = points[2 * p + 1];
+    }
+  }
+  std::vector<Real> recv_points(2 * recv_offsets[nranks]);
+  MPI_Alltoallv(send_points.data(), scaled(send_counts, 2).data(),
+                scaled(send_offsets, 2).data(), MPI_DOUBLE, recv_points.data(),
+                scaled(recv_counts, 2).data(), scaled(recv_offsets, 2).data(),
+                MPI_DOUBLE, comm);
+  std::vector<Real> remote_values;
+  std::vector<Real> remote_distances_squared;
+  evaluate(recv_points, remote_values, remote_distances_squared);
+  // each reply is the squared distance followed by the values
+  const int reply_size = ncomponents + 1;
+  std::vector<Real> send_replies(reply_size * recv_offsets[nranks]);
+  for (int i = 0; i < recv_offsets[nranks]; ++i) {
+    send_replies[reply_size * i] = remote_distances_squared[i];
+    std::copy_n(&remote_values[ncomponents * i], ncomponents,
+                &send_replies[reply_size * i + 1]);
+  }
+  std::vector<Real> recv_replies(reply_size * send_offsets[nranks]);
+  MPI_Alltoallv(send_replies.data(), scaled(recv_counts, reply_size).data(),
+                scaled(recv_offsets, reply_size).data(), MPI_DOUBLE,
+                recv_replies.data(), scaled(send_counts, reply_size).data(),
+                scaled(send_offsets, reply_size).data(), MPI_DOUBLE, comm);
+  for (int r = 0; r < nranks; ++r) {
+    for (std::size_t k = 0; k < requests[r].size(); ++k) {
+      const auto p = requests[r][k];
+      const Real* reply = &recv_replies[reply_size * (send_offsets[r] + k)];
+      const auto distance_squared = reply[0];
+      if (distance_squared < best.distances_squared[p] ||
+          (distance_squared == best.distances_squared[p] &&
+           r < best.ranks[p])) {
+        std::copy_n(reply + 1, ncomponents, &best.values[ncomponents * p]);
+        best.distances_squared[p] = distance_squared;
+        best.ranks[p] = r;
+      }
+    }
+  }
+}
+} // namespace
+
+DistributedPointSearch::DistributedPointSearch(Omega_h::Mesh& mesh,
+                                               MPI_Comm comm, LO nx, LO ny)
+  : comm_(comm),
+    coords_(mesh.coords()),
+    tris2verts_(mesh.ask_elem_verts()),
+    nverts_(mesh.nverts())
+{
+  PCMS_FUNCTION_TIMER;
+  PCMS_ALWAYS_ASSERT(mesh.dim() == 2);
+  int nranks = 0;
+  MPI_Comm_size(comm_, &nranks);
+  // the bounds of the local elements. Omega_h::get_bounding_box would
+  // reduce over the whole mesh
+  std::array<Real, 4> local_bounds{0, 0, -1, -1};
+  if (mesh.nelems() > 0) {
+    search_.emplace(mesh.coords(), tris2verts_, nx, ny);
+    const auto bbox = Omega_h::find_bounding_box<2>(mesh.coords());
+    for (int i = 0; i < 2; ++i) {
+      local_bounds[i] = (bbox.max[i] + bbox.min[i]) / 2;
+      local_bounds[2 + i] = (bbox.max[i] - bbox.min[i]) / 2;
+    }
+  }
+  std::vector<Real> bounds(4 * nranks);
+  MPI_Allgather(local_bounds.data(), 4, MPI_DOUBLE, bounds.data(), 4,
+                MPI_DOUBLE, comm_);
+  partition_bounds_.resize(nranks);
+  for (int r = 0; r < nranks; ++r) {
+    partition_bounds_[r] = {.center = {bounds[4 * r], bounds[4 * r + 1]},
+                            .half_width = {bounds[4 * r + 2],
+                                           bounds[4 * r + 3]}};
+  }
+}
+
+void DistributedPointSearch::EvaluateLocal(
+  Kokkos::View<Real* [2]> points, Omega_h::Reals nodal_values,
+  int ncomponents, Omega_h::Write<Real> values,
+  Omega_h::Write<Real> distances_squared) const
+{
+  PCMS_FUNCTION_TIMER;
+  const LO npoints = points.extent(0);
+  // any element of another partition is closer
+  const Real far = std::numeric_limits<Real>::max();
+  if (!search_) {
+    Omega_h::parallel_for(
+      npoints, OMEGA_H_LAMBDA(LO i) {
+        for (int c = 0; c < ncomponents; ++c) {
+          values[ncomponents * i + c] = 0;
+        }
+        distances_squared[i] = far;
+      });
+    return;
+  }
+  auto results = (*search_)(points);
+  auto tris2verts = tris2verts_;
+  auto coords = coords_;
+  Kokkos::parallel_for(
+    npoints, KOKKOS_LAMBDA(LO i) {
+      // meshes without elements have no closest element
+      if (!results(i).Found()) {
+        for (int c = 0; c < ncomponents; ++c) {
+          values[ncomponents * i + c] = 0;
+        }
+        distances_squared[i] = far;
+        return;
+      }
+      // points outside of the local partition use the closest element
+      const auto elem_idx = results(i).ElementId();
+      const auto coord = results(i).parametric_coords;
+      const auto elem_tri2verts =
+        Omega_h::gather_verts<3>(tris2verts, elem_idx);
+      for (int c = 0; c < ncomponents; ++c) {
+        Real val = 0;
+        for (int j = 0; j < 3; ++j) {
+          val += nodal_values[ncomponents * elem_tri2verts[j] + c] * coord[j];
+        }
+        values[ncomponents * i + c] = val;
+      }
+      // distance to the closest point of the element, which the parametric
+      // coordinates describe for points outside of the partition
+      Real distance_squared = 0;
+      if (!results(i).Inside()) {
+        for (int d = 0; d < 2; ++d) {
+          Real x = 0;
+          for (int j = 0; j < 3; ++j) {
+            x += coords[2 * elem_tri2verts[j] + d] * coord[j];
+          }
+          distance_squared += (x - points(i, d)) * (x - points(i, d));
+        }
+      }
+      distances_squared[i] = distance_squared;
+    });
+}
+
+Omega_h::Reals DistributedPointSearch::Evaluate(Kokkos::View<Real* [2]> points,
+                                                Omega_h::Reals nodal_values,
+                                                int ncomponents) const
+{
+  PCMS_FUNCTION_TIMER;
+  PCMS_ALWAYS_ASSERT(ncomponents > 0);
+  PCMS_ALWAYS_ASSERT(nodal_values.size() == nverts_ * ncomponents);
+  int rank = -1;
+  MPI_Comm_rank(comm_, &rank);
+  const LO npoints = points.extent(0);
+  Omega_h::Write<Real> values(npoints * ncomponents);
+  Omega_h::Write<Real> distances_squared(npoints);
+  EvaluateLocal(points, nodal_values, ncomponents, values, distances_squared);
+  // the unresolved points are exchanged on the host
+  auto points_h =
+    Kokkos::create_mirror_view_and_copy(Kokkos::HostSpace{}, points);
+  Omega_h::HostRead<Real> values_h(values);
+  Omega_h::HostRead<Real> distances_squared_h(distances_squared);
+  std::vector<Real> host_points(2 * npoints);
+  for (LO p = 0; p < npoints; ++p) {
+    host_points[2 * p] = points_h(p, 0);
+    host_points[2 * p + 1] = points_h(p, 1);
+  }
+  PointEvaluations best;
+  best.values.assign(values_h.data(), values_h.data() + values_h.size());
+  best.distances_squared.assign(
+    distances_squared_h.data(),
+    distances_squared_h.data() + distances_squared_h.size());
+  best.ranks.assign(npoints, rank);
+  auto evaluate_remote = [&](const std::vector<Real>& remote_points,
+                             std::vector<Real>& remote_values,
+                             std::vector<Real>& remote_distances_squared) {
+    const LO nremote = remote_points.size() / 2;
+    Kokkos::View<Real* [2]> remote("remote points", nremote);
+    auto remote_h = Kokkos::create_mirror_view(remote);
+    for (LO i = 0; i < nremote; ++i) {
+      remote_h(i, 0) = remote_points[2 * i];
+      remote_h(i, 1) = remote_points[2 * i + 1];
+    }
+    Kokkos::deep_copy(remote, remote_h);
+    Omega_h::Write<Real> evaluated(nremote * ncomponents);
+    Omega_h::Write<Real> evaluated_distances_squared(nremote);
+    EvaluateLocal(remote, nodal_values, ncomponents, evaluated,
+                  evaluated_distances_squared);
+    Omega_h::HostRead<Real> evaluated_h(evaluated);
+    Omega_h::HostRead<Real> evaluated_distances_squared_h(
+      evaluated_distances_squared);
+    remote_values.assign(evaluated_h.data(),
+                         evaluated_h.data() + evaluated_h.size());
+    remote_distances_squared.assign(evaluated_distances_squared_h.data(),
+                                    evaluated_distances_squared_h.data() +
+                                      evaluated_distances_squared_h.size());
+  };
+  // points that are not inside of a local element are searched for on the
+  // ranks whose partition contains them
+  exchange_points(
+    comm_, host_points, ncomponents,
+    [&](std::size_t p, int r) {
+      return best.distances_squared[p] > 0 &&
+             within_bounds(&host_points[2 * p], partition_bounds_[r]);
+    },
+    evaluate_remote, best);
+  // the remaining points are outside of the whole mesh and use the closest
+  // element over all partitions. Only partitions whose bounds are closer than
+  // the closest element found so far can contain a closer element
+  exchange_points(
+    comm_, host_points, ncomponents,
+    [&](std::size_t p, int r) {
+      const auto* point = &host_points[2 * p];
+      return best.distances_squared[p] > 0 &&
+             partition_bounds_[r].half_width[0] >= 0 &&
+             !within_bounds(point, partition_bounds_[r]) &&
+             distance_squared_to_bounds(point, partition_bounds_[r]) <=
+               best.distances_squared[p];
+    },
+    evaluate_remote, best);
+  Omega_h::HostWrite<Real> result(npoints * ncomponents);
+  std::copy(best.values.begin(), best.values.end(), result.data());
+  return Omega_h::Reals(result.write());
+}
+} // namespace pcms
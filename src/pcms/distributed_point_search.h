@@ -0,0 +1,72 @@
+#ifndef PCMS_COUPLING_DISTRIBUTED_POINT_SEARCH_H
+#define PCMS_COUPLING_DISTRIBUTED_POINT_SEARCH_H
+#include "pcms/point_search.h"
+#include <mpi.h>
+#include <optional>
+#include <vector>
+
+namespace pcms
+{
+/**
+ * Point search and evaluation over a 2D mesh that is partitioned across the
+ * ranks of a communicator.
+ *
+ * Each rank searches its own part of the mesh. A point that is not inside
+ * any local element is sent to every rank whose partition bounding box
+ * contains it. Those ranks evaluate it and return the values, and the
+ * lowest rank that contains the point wins. A point outside of the whole
+ * mesh is evaluated at the closest point of the closest element over all
+ * partitions, with ties going to the lowest rank. This allows interpolation
+ * between meshes that are partitioned differently.
+ *
+ * \Warning construction and evaluation are collective over the communicator
+ */
+class DistributedPointSearch
+{
+public:
+  /**
+   * @param mesh the local part of the mesh
+   * @param comm communicator over all ranks that hold a part of the mesh
+   * @param nx number of grid cells in the x direction of the local search
+   * @param ny number of grid cells in the y direction of the local search
+   */
+  DistributedPointSearch(Omega_h::Mesh& mesh, MPI_Comm comm, LO nx = 0,
+                         LO ny = 0);
+  /**
+   * linear (Lagrange<1>) interpolation of vertex values at the points
+   * @param points points on this rank, which may lie in any partition
+   * @param nodal_values values on the local vertices with ncomponents
+   * entries per vertex
+   * @return ncomponents values for each point
+   */
+  [[nodiscard]] Omega_h::Reals Evaluate(Kokkos::View<Real* [2]> points,
+                                        Omega_h::Reals nodal_values,
+                                        int ncomponents = 1) const;
+  /// bounding box of the local elements of each rank. Ranks without elements
+  /// have a negative half width
+  [[nodiscard]] const std::vector<AABBox<2>>& GetPartitionBounds()
+    const noexcept
+  {
+    return partition_bounds_;
+  }
+  [[nodiscard]] MPI_Comm GetComm() const noexcept { return comm_; }
+
+private:
+  /// evaluate at points using only the local part of the mesh. The squared
+  /// distance from each point to the element it is evaluated on is zero if
+  /// the point is inside of the local part of the mesh
+  void EvaluateLocal(Kokkos::View<Real* [2]> points,
+                     Omega_h::Reals nodal_values, int ncomponents,
+                     Omega_h::Write<Real> values,
+                     Omega_h::Write<Real> distances_squared) const;
+  MPI_Comm comm_;
+  Omega_h::Reals coords_;
+  // empty if the local part of the mesh has no elements
+  std::optional<GridPointSearch> search_;
+  Omega_h::LOs tris2verts_;
+  LO nverts_;
+  std::vector<AABBox<2>> partition_bounds_;
+};
+} // namespace pcms
+
+#endif // PCMS_COUPLING_DISTRIBUTED_POINT_SEARCH_H
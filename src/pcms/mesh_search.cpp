@@ -0,0 +1,73 @@
+#include "pcms/mesh_search.h"
+#include "pcms/profile.h"
+#include <map>
+#include <mutex>
+#include <tuple>
+
+namespace pcms
+{
+MeshSearch::MeshSearch(Omega_h::Mesh& mesh, LO nx, LO ny)
+  : mesh_(mesh), nx_(nx), ny_(ny), coords_(mesh.coords())
+{
+}
+
+bool MeshSearch::IsCurrent() const
+{
+  const auto coords = mesh_.coords();
+  return coords.data() == coords_.data() && coords.size() == coords_.size();
+}
+
+void MeshSearch::InvalidateIfChanged()
+{
+  if (!IsCurrent()) {
+    search_.reset();
+    stencils_.Clear();
+    coords_ = mesh_.coords();
+  }
+}
+
+const GridPointSearch& MeshSearch::ConstructedSearch()
+{
+  if (!search_) {
+    PCMS_FUNCTION_TIMER;
+    search_.emplace(mesh_, nx_, ny_);
+  }
+  return *search_;
+}
+
+Kokkos::View<GridPointSearch::Result*> MeshSearch::Search(
+  Kokkos::View<Real* [2]> points)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  InvalidateIfChanged();
+  return ConstructedSearch()(points);
+}
+
+bool MeshSearch::IsConstructed() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return search_.has_value();
+}
+
+std::shared_ptr<MeshSearch> get_mesh_search(Omega_h::Mesh& mesh, LO nx, LO ny)
+{
+  PCMS_FUNCTION_TIMER;
+  // the registry only holds weak references, so the search is released
+  // when the last field on the mesh is destroyed
+  static std::mutex registry_mutex;
+  static std::map<std::tuple<const Omega_h::Mesh*, LO, LO>,
+                  std::weak_ptr<MeshSearch>>
+    registry;
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  for (auto it = registry.begin(); it != registry.end();) {
+    it = it->second.expired() ? registry.erase(it) : std::next(it);
+  }
+  auto& entry = registry[{&mesh, nx, ny}];
+  auto search = entry.lock();
+  if (!search || !search->IsCurrent()) {
+    search = std::make_shared<MeshSearch>(mesh, nx, ny);
+    entry = search;
+  }
+  return search;
+}
+} // namespace pcms
@@ -0,0 +1,143 @@
+#ifndef PCMS_COUPLING_MESH_SEARCH_H
+#define PCMS_COUPLING_MESH_SEARCH_H
+#include "pcms/point_search.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace pcms
+{
+namespace detail
+{
+template <typename Coordinate>
+bool equal_coordinates(const Kokkos::View<Real*>& cached,
+                       const Kokkos::View<const Coordinate*>& coordinates)
+{
+  if (cached.extent(0) != coordinates.extent(0)) {
+    return false;
+  }
+  LO mismatches = 0;
+  Kokkos::parallel_reduce(
+    cached.extent(0),
+    KOKKOS_LAMBDA(LO i, LO & local_mismatches) {
+      local_mismatches += (cached(i) != static_cast<Real>(coordinates(i)));
+    },
+    mismatches);
+  return mismatches == 0;
+}
+
+/**
+ * Interpolation stencils (the element and barycentric weights of each point)
+ * for the coordinate sets that a mesh was most recently evaluated at. The
+ * target coordinates of a coupled field do not change between steps, so
+ * repeat evaluations skip the point search.
+ */
+class StencilCache
+{
+public:
+  using Stencil = Kokkos::View<GridPointSearch::Result*>;
+  static constexpr std::size_t max_entries = 4;
+  /// return the stencil for the coordinates, calling compute to construct it
+  /// if it is not cached. The hash is only used to skip the comparison with
+  /// entries that cannot match. A hit requires the coordinates to be equal to
+  /// the cached copy
+  template <typename Coordinate, typename Compute>
+  Stencil GetOrCompute(Kokkos::View<const Coordinate*> coordinates,
+                       std::uint64_t hash, Compute&& compute)
+  {
+    for (const auto& entry : entries_) {
+      if (entry.hash == hash &&
+          equal_coordinates(entry.coordinates, coordinates)) {
+        return entry.stencil;
+      }
+    }
+    if (entries_.size() == max_entries) {
+      entries_.erase(entries_.begin());
+    }
+    Kokkos::View<Real*> cached_coordinates(
+      Kokkos::ViewAllocateWithoutInitializing("stencil coordinates"),
+      coordinates.extent(0));
+    Kokkos::parallel_for(
+      coordinates.extent(0),
+      KOKKOS_LAMBDA(LO i) { cached_coordinates(i) = coordinates(i); });
+    entries_.push_back({hash, cached_coordinates, compute()});
+    return entries_.back().stencil;
+  }
+  void Clear() { entries_.clear(); }
+
+private:
+  struct Entry
+  {
+    std::uint64_t hash;
+    Kokkos::View<Real*> coordinates;
+    Stencil stencil;
+  };
+  std::vector<Entry> entries_;
+};
+} // namespace detail
+
+/**
+ * Point search of a mesh that is shared by all of the fields on the mesh.
+ * The search structure is built on the first search, so fields that are only
+ * copied never pay for it. The search and stencils belong to the coordinate
+ * array of the mesh, so they are rebuilt if the mesh coordinates are replaced.
+ * The search and stencils are only used while holding the lock, so another
+ * thread cannot rebuild them while they are in use.
+ */
+class MeshSearch
+{
+public:
+  MeshSearch(Omega_h::Mesh& mesh, LO nx, LO ny);
+  /// locate the points in the mesh
+  [[nodiscard]] Kokkos::View<GridPointSearch::Result*> Search(
+    Kokkos::View<Real* [2]> points);
+  /**
+   * return the stencil for the coordinates, searching the points returned by
+   * get_points if it is not cached
+   * @param hash hash of the coordinates used to skip the comparison with
+   * stencils that cannot match
+   */
+  template <typename Coordinate, typename GetPoints>
+  [[nodiscard]] detail::StencilCache::Stencil GetOrComputeStencil(
+    Kokkos::View<const Coordinate*> coordinates, std::uint64_t hash,
+    GetPoints&& get_points)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    InvalidateIfChanged();
+    return stencils_.GetOrCompute(coordinates, hash, [&]() {
+      return ConstructedSearch()(get_points());
+    });
+  }
+  [[nodiscard]] bool IsConstructed() const;
+  /// true if the mesh still has the coordinates the search was built for
+  [[nodiscard]] bool IsCurrent() const;
+
+private:
+  // drop the search and stencils if the mesh coordinates changed. Requires
+  // the mutex to be held
+  void InvalidateIfChanged();
+  // the search, built on first use. Requires the mutex to be held
+  const GridPointSearch& ConstructedSearch();
+  Omega_h::Mesh& mesh_;
+  LO nx_;
+  LO ny_;
+  // holding the coordinates keeps their address from being reused, so the
+  // address identifies the coordinates that the search was built for
+  Omega_h::Reals coords_;
+  mutable std::mutex mutex_;
+  std::optional<GridPointSearch> search_;
+  detail::StencilCache stencils_;
+};
+
+/// search shared by the fields on the mesh that use the same grid size. A
+/// new search is created if no existing field on the mesh uses one, or if the
+/// existing search was built for different coordinates (e.g., a new mesh at
+/// the address of a destroyed one).
+[[nodiscard]] std::shared_ptr<MeshSearch> get_mesh_search(Omega_h::Mesh& mesh,
+                                                          LO nx = 0,
+                                                          LO ny = 0);
+} // namespace pcms
+
+#endif // PCMS_COUPLING_MESH_SEARCH_H
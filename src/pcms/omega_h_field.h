@@ -7,11 +7,16 @@
 #include "pcms/coordinate_systems.h"
 #include <Kokkos_Core.hpp>
 #include <array>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <vector>
 #include <pcms/assert.h>
 #include <Omega_h_for.hpp>
 #include "pcms/arrays.h"
 #include "pcms/array_mask.h"
-#include "pcms/point_search.h"
+#include "pcms/mesh_search.h"
 #include <redev_variant_tools.h>
 #include <type_traits>
 #include "pcms/transfer_field.h"
@@ -108,6 +113,35 @@ struct GetRankOmegaH
   Omega_h::I8 dim_;
   std::array<pcms::Real,3> coord_;
 };
+KOKKOS_INLINE_FUNCTION
+std::uint64_t mix_bits(std::uint64_t x)
+{
+  // splitmix64 finalizer
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+/// hash of the contents of an array. The position of each entry is part of
+/// the hash, so a permutation of the same values hashes differently
+template <typename T, typename MemorySpace>
+std::uint64_t hash_array(ScalarArrayView<const T, MemorySpace> array)
+{
+  PCMS_FUNCTION_TIMER;
+  static_assert(sizeof(T) <= sizeof(std::uint64_t),
+                "array entries must fit in 64 bits");
+  using ExecutionSpace = typename MemorySpace::execution_space;
+  std::uint64_t hash = 0;
+  Kokkos::parallel_reduce(
+    Kokkos::RangePolicy<ExecutionSpace>(0, array.size()),
+    KOKKOS_LAMBDA(LO i, std::uint64_t & local_hash) {
+      std::uint64_t bits = 0;
+      memcpy(&bits, &array(i), sizeof(T));
+      local_hash += mix_bits(bits ^ mix_bits(i));
+    },
+    hash);
+  return hash;
+}
 } // namespace detail
 
 template <typename T,
@@ -121,12 +155,12 @@ public:
   using coordinate_element_type = CoordinateElementType;
 
   OmegaHField(std::string name, Omega_h::Mesh& mesh,
-              std::string global_id_name = "", int search_nx = 10,
-              int search_ny = 10, 
+              std::string global_id_name = "", int search_nx = 0,
+              int search_ny = 0, 
               mesh_entity_type entity_type = mesh_entity_type::VERTEX)
     : name_(std::move(name)),
       mesh_(mesh),
-      search_{mesh, search_nx, search_ny},
+      search_{get_mesh_search(mesh, search_nx, search_ny)},
       size_(mesh.nents(mesh_entity_to_int(entity_type))),
       global_id_name_(std::move(global_id_name)),
       entity_type_(entity_type)
@@ -135,11 +169,11 @@ public:
   }
   OmegaHField(std::string name, Omega_h::Mesh& mesh,
               Omega_h::Read<Omega_h::I8> mask, std::string global_id_name = "",
-              int search_nx = 10, int search_ny = 10, 
+              int search_nx = 0, int search_ny = 0, 
               mesh_entity_type entity_type = mesh_entity_type::VERTEX)
     : name_(std::move(name)),
       mesh_(mesh),
-      search_{mesh, search_nx, search_ny},
+      search_{get_mesh_search(mesh, search_nx, search_ny)},
       global_id_name_(std::move(global_id_name)),
       entity_type_(entity_type)
   {
@@ -179,7 +213,30 @@ public:
   // pass through to search function
   auto Search(Kokkos::View<Real* [2]> points) const {
     PCMS_FUNCTION_TIMER;
-    return search_(points); }
+    return search_->Search(points); }
+  /// search structure shared by all of the fields on the mesh
+  [[nodiscard]] const std::shared_ptr<MeshSearch>& GetMeshSearch()
+    const noexcept
+  {
+    return search_;
+  }
+  /**
+   * search results for interleaved 2D coordinates. The results are cached
+   * by the contents of the coordinate array, so evaluating at the same
+   * coordinates again only hashes and compares the coordinates rather than
+   * searching.
+   */
+  template <typename Coordinate>
+  [[nodiscard]] detail::StencilCache::Stencil GetStencil(
+    ScalarArrayView<const Coordinate, memory_space> coordinates) const
+  {
+    PCMS_FUNCTION_TIMER;
+    const auto hash = detail::hash_array(coordinates);
+    return search_->GetOrComputeStencil(
+      Kokkos::View<const Coordinate*>(coordinates.data_handle(),
+                                      coordinates.size()),
+      hash, [&]() { return InterleavedToPoints(coordinates); });
+  }
 
   [[nodiscard]] Omega_h::Read<Omega_h::ClassId> GetClassIDs() const
   {
@@ -224,9 +281,22 @@ public:
     return gid_array;
   }
 private:
+  template <typename Coordinate>
+  Kokkos::View<Real* [2]> InterleavedToPoints(
+    ScalarArrayView<const Coordinate, memory_space> coordinates) const
+  {
+    Kokkos::View<Real* [2]> coords("coords", coordinates.size() / 2);
+    Kokkos::parallel_for(
+      coordinates.size() / 2, KOKKOS_LAMBDA(LO i) {
+        coords(i, 0) = coordinates(2 * i);
+        coords(i, 1) = coordinates(2 * i + 1);
+      });
+    return coords;
+  }
   std::string name_;
   Omega_h::Mesh& mesh_;
-  GridPointSearch search_;
+  // shared by all fields on the mesh and constructed on the first search
+  std::shared_ptr<MeshSearch> search_;
   // bitmask array that specifies a filter on the field
   Omega_h::Read<LO> mask_;
   LO size_;
@@ -341,20 +411,19 @@ auto evaluate(
   Omega_h::Write<T> values(coordinates.size() / 2);
   auto tris2verts = field.GetMesh().ask_elem_verts();
   auto field_values = field.GetMesh().template get_array<T>(0, field.GetName());
-
-  Kokkos::View<Real* [2]> coords("coords", coordinates.size() / 2);
-  Kokkos::parallel_for(
-    coordinates.size() / 2, KOKKOS_LAMBDA(LO i) {
-      coords(i, 0) = coordinates(2 * i);
-      coords(i, 1) = coordinates(2 * i + 1);
-    });
-  auto results = field.Search(coords);
+  auto results = field.GetStencil(coordinates);
 
   Kokkos::parallel_for(
     results.size(), KOKKOS_LAMBDA(LO i) {
-      auto [elem_idx, coord] = results(i);
-      // TODO deal with case for elem_idx < 0 (point outside of mesh)
-      KOKKOS_ASSERT(elem_idx >= 0);
+      // meshes without elements have no closest element
+      if (!results(i).Found()) {
+        values[i] = 0;
+        return;
+      }
+      // points outside of the mesh use the closest point on the closest
+      // element
+      const auto elem_idx = results(i).ElementId();
+      const auto coord = results(i).parametric_coords;
       const auto elem_tri2verts =
         Omega_h::gather_verts<3>(tris2verts, elem_idx);
       Real val = 0;
@@ -381,20 +450,19 @@ auto evaluate(
   Omega_h::Write<T> values(coordinates.size() / 2);
   auto tris2verts = field.GetMesh().ask_elem_verts();
   auto field_values = field.GetMesh().template get_array<T>(0, field.GetName());
-  // TODO reuse coordinates_data if possible
-  Kokkos::View<Real* [2]> coords("coords", coordinates.size() / 2);
-  Kokkos::parallel_for(
-    coordinates.size() / 2, KOKKOS_LAMBDA(LO i) {
-      coords(i, 0) = coordinates(2 * i);
-      coords(i, 1) = coordinates(2 * i + 1);
-    });
-  auto results = field.Search(coords);
+  auto results = field.GetStencil(coordinates);
 
   Kokkos::parallel_for(
     results.size(), KOKKOS_LAMBDA(LO i) {
-      auto [elem_idx, coord] = results(i);
-      // TODO deal with case for elem_idx < 0 (point outside of mesh)
-      KOKKOS_ASSERT(elem_idx >= 0);
+      // meshes without elements have no closest element
+      if (!results(i).Found()) {
+        values[i] = 0;
+        return;
+      }
+      // points outside of the mesh use the closest point on the closest
+      // element
+      const auto elem_idx = results(i).ElementId();
+      const auto coord = results(i).parametric_coords;
       const auto elem_tri2verts =
         Omega_h::gather_verts<3>(tris2verts, elem_idx);
       // value is closest to point has the largest coordinate
@@ -412,6 +480,109 @@ auto evaluate(
   return values;
 }
 
+namespace detail
+{
+/// pointer to the data of an array that can be stored in a Kokkos::View to
+/// pass a runtime number of arrays to a kernel
+template <typename T>
+struct ArrayPointer
+{
+  T* data;
+};
+} // namespace detail
+
+/**
+ * Evaluate several fields that are defined on the same mesh at the same
+ * coordinates. The coordinates are searched once and every field is
+ * evaluated in a single kernel that reuses the element and weights of each
+ * point.
+ * @return the values of each field in the order of the input fields
+ */
+template <typename T, typename CoordinateElementType, typename Method>
+auto evaluate_many(
+  nonstd::span<
+    const std::reference_wrapper<const OmegaHField<T, CoordinateElementType>>>
+    fields,
+  Method /* method */,
+  ScalarArrayView<const CoordinateElementType, OmegaHMemorySpace::type>
+    coordinates) -> std::vector<Omega_h::Read<T>>
+{
+  PCMS_FUNCTION_TIMER;
+  static_assert(std::is_same_v<Method, Lagrange<1>> ||
+                  std::is_same_v<Method, NearestNeighbor>,
+                "evaluate_many supports Lagrange<1> and NearestNeighbor");
+  if (fields.empty()) {
+    return {};
+  }
+  const auto& first_field = fields[0].get();
+  const LO npoints = coordinates.size() / 2;
+  const LO nfields = fields.size();
+  using memory_space = OmegaHMemorySpace::type;
+  Kokkos::View<detail::ArrayPointer<const T>*, memory_space> sources(
+    "source data", nfields);
+  Kokkos::View<detail::ArrayPointer<T>*, memory_space> targets("target data",
+                                                               nfields);
+  auto sources_h = Kokkos::create_mirror_view(sources);
+  auto targets_h = Kokkos::create_mirror_view(targets);
+  // keep the arrays alive until the kernel is done
+  std::vector<Omega_h::Read<T>> field_values;
+  std::vector<Omega_h::Write<T>> values;
+  field_values.reserve(nfields);
+  values.reserve(nfields);
+  for (LO f = 0; f < nfields; ++f) {
+    const auto& field = fields[f].get();
+    // the search is only valid for fields on the same mesh
+    PCMS_ALWAYS_ASSERT(&field.GetMesh() == &first_field.GetMesh());
+    field_values.push_back(
+      field.GetMesh().template get_array<T>(0, field.GetName()));
+    values.emplace_back(npoints);
+    sources_h(f).data = field_values.back().data();
+    targets_h(f).data = values.back().data();
+  }
+  Kokkos::deep_copy(sources, sources_h);
+  Kokkos::deep_copy(targets, targets_h);
+  auto tris2verts = first_field.GetMesh().ask_elem_verts();
+  auto results = first_field.GetStencil(coordinates);
+  Kokkos::parallel_for(
+    npoints, KOKKOS_LAMBDA(LO i) {
+      // meshes without elements have no closest element
+      if (!results(i).Found()) {
+        for (LO f = 0; f < nfields; ++f) {
+          targets(f).data[i] = 0;
+        }
+        return;
+      }
+      // points outside of the mesh use the closest point on the closest
+      // element
+      const auto elem_idx = results(i).ElementId();
+      const auto coord = results(i).parametric_coords;
+      const auto elem_tri2verts =
+        Omega_h::gather_verts<3>(tris2verts, elem_idx);
+      if constexpr (std::is_same_v<Method, NearestNeighbor>) {
+        // value is closest to point has the largest coordinate
+        int vert = 0;
+        for (int j = 1; j <= 2; ++j) {
+          vert = (coord[j] > coord[vert]) ? j : vert;
+        }
+        for (LO f = 0; f < nfields; ++f) {
+          targets(f).data[i] = sources(f).data[elem_tri2verts[vert]];
+        }
+      } else {
+        for (LO f = 0; f < nfields; ++f) {
+          Real val = 0;
+          for (int j = 0; j < 3; ++j) {
+            val += sources(f).data[elem_tri2verts[j]] * coord[j];
+          }
+          if constexpr (std::is_integral_v<T>) {
+            val = std::round(val);
+          }
+          targets(f).data[i] = val;
+        }
+      }
+    });
+  return {values.begin(), values.end()};
+}
+
 template <typename T, typename Method, typename CoordinateElementType>
 auto evaluate(
   const OmegaHField<T, CoordinateElementType>& field, Method&& m,
@@ -494,8 +665,8 @@ public:
   using value_type = T;
   using coordinate_element_type = CoordinateElementType;
   OmegaHFieldAdapter(std::string name, Omega_h::Mesh& mesh,
-                     std::string global_id_name = "", int search_nx = 10,
-                     int search_ny = 10, mesh_entity_type entity_type = mesh_entity_type::VERTEX)
+                     std::string global_id_name = "", int search_nx = 0,
+                     int search_ny = 0, mesh_entity_type entity_type = mesh_entity_type::VERTEX)
     : field_{std::move(name), mesh, std::move(global_id_name), search_nx,
              search_ny, entity_type}, entity_type_{entity_type}
   {
@@ -504,8 +675,8 @@ public:
 
   OmegaHFieldAdapter(std::string name, Omega_h::Mesh& mesh,
                      Omega_h::Read<Omega_h::I8> mask,
-                     std::string global_id_name = "", int search_nx = 10,
-                     int search_ny = 10, mesh_entity_type entity_type = mesh_entity_type::VERTEX)
+                     std::string global_id_name = "", int search_nx = 0,
+                     int search_ny = 0, mesh_entity_type entity_type = mesh_entity_type::VERTEX)
     : field_{std::move(name),           mesh,      mask,
              std::move(global_id_name), search_nx, search_ny, entity_type}, entity_type_{entity_type}
   {
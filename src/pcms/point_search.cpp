@@ -1,24 +1,41 @@
 #include "point_search.h"
 #include <Omega_h_mesh.hpp>
+#include <Kokkos_Sort.hpp>
+#include <algorithm>
 #include <bitset>
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <vector>
+#include "pcms/assert.h"
 
 namespace pcms
 {
 constexpr Real fuzz = 1E-6;
 
+template <int dim>
+KOKKOS_INLINE_FUNCTION AABBox<dim> simplex_bbox(
+  const Omega_h::Matrix<dim, dim + 1>& coords)
+{
+  AABBox<dim> bbox;
+  for (int j = 0; j < dim; ++j) {
+    Real max = coords(j, 0);
+    Real min = coords(j, 0);
+    for (int i = 1; i < dim + 1; ++i) {
+      max = std::fmax(max, coords(j, i));
+      min = std::fmin(min, coords(j, i));
+    }
+    bbox.center[j] = (max + min) / 2.0;
+    bbox.half_width[j] = (max - min) / 2.0;
+  }
+  return bbox;
+}
 KOKKOS_INLINE_FUNCTION
 AABBox<2> triangle_bbox(const Omega_h::Matrix<2, 3>& coords)
 {
-  std::array<Real, 2> max{coords(0, 0), coords(1, 0)};
-  std::array<Real, 2> min{coords(0, 0), coords(1, 0)};
-  for (int i = 1; i < 3; ++i) {
-    max[0] = std::fmax(max[0], coords(0, i));
-    max[1] = std::fmax(max[1], coords(1, i));
-    min[0] = std::fmin(min[0], coords(0, i));
-    min[1] = std::fmin(min[1], coords(1, i));
-  }
-  return {.center = {(max[0] + min[0]) / 2.0, (max[1] + min[1]) / 2.0},
-          .half_width = {(max[0] - min[0]) / 2.0, (max[1] - min[1]) / 2.0}};
+  return simplex_bbox<2>(coords);
 }
 // Liang, You-Dong, and B. A. Barsky. “A New Concept and Method for Line
 // Clipping.” ACM Transactions on Graphics 3, no. 1 (January 1984): 1–22.
@@ -137,88 +154,543 @@ bool triangle_intersects_bbox(const Omega_h::Matrix<2, 3>& coords,
   return false;
 }
 
+/**
+ * Check if a tetrahedron represented by 4 coordinates in three dimensions
+ * intersects with a bounding box. Uses the separating axis theorem with the
+ * box face normals, the tetrahedron face normals and the cross products of
+ * the box and tetrahedron edges.
+ */
+[[nodiscard]] KOKKOS_FUNCTION bool tetrahedron_intersects_bbox(
+  const Omega_h::Matrix<3, 4>& coords, const AABBox<3>& bbox)
+{
+  if (!intersects(simplex_bbox<3>(coords), bbox)) {
+    return false;
+  }
+  // vertices relative to the center of the box
+  Omega_h::Matrix<3, 4> verts;
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      verts(j, i) = coords(j, i) - bbox.center[j];
+    }
+  }
+  auto separated = [&](const Omega_h::Vector<3>& axis) {
+    if (Omega_h::norm_squared(axis) == 0) {
+      // parallel edges do not give a separating axis
+      return false;
+    }
+    Real min = axis * verts[0];
+    Real max = min;
+    for (int i = 1; i < 4; ++i) {
+      const Real projection = axis * verts[i];
+      min = (projection < min) ? projection : min;
+      max = (projection > max) ? projection : max;
+    }
+    Real radius = 0;
+    for (int j = 0; j < 3; ++j) {
+      radius += bbox.half_width[j] * std::abs(axis[j]);
+    }
+    radius += fuzz * radius;
+    return min > radius || max < -radius;
+  };
+  // the box face normals are covered by the bounding box check
+  constexpr int edges[6][2] = {{0, 1}, {0, 2}, {0, 3}, {1, 2}, {1, 3}, {2, 3}};
+  for (int face = 0; face < 4; ++face) {
+    const auto& a = verts[(face + 1) % 4];
+    const auto& b = verts[(face + 2) % 4];
+    const auto& c = verts[(face + 3) % 4];
+    if (separated(Omega_h::cross(b - a, c - a))) {
+      return false;
+    }
+  }
+  for (const auto& edge : edges) {
+    const auto e = verts[edge[1]] - verts[edge[0]];
+    for (int j = 0; j < 3; ++j) {
+      Omega_h::Vector<3> box_edge{0, 0, 0};
+      box_edge[j] = 1;
+      if (separated(Omega_h::cross(e, box_edge))) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+KOKKOS_FUNCTION
+Omega_h::Vector<3> barycentric_from_global(
+  const Omega_h::Vector<2>& point, const Omega_h::Matrix<2, 3>& vertex_coords)
+{
+  const auto inverse_basis =
+    Omega_h::pseudo_invert(Omega_h::simplex_basis<2, 2>(vertex_coords));
+  auto xi = inverse_basis * (point - vertex_coords[0]);
+  // note omega_h form_barycentric is currently broken.
+  // see https://github.com/sandialabs/omega_h/issues/389
+  return {1 - xi[0] - xi[1], xi[0], xi[1]};
+}
+
+KOKKOS_FUNCTION
+Omega_h::Vector<4> barycentric_from_global(
+  const Omega_h::Vector<3>& point, const Omega_h::Matrix<3, 4>& vertex_coords)
+{
+  const auto inverse_basis =
+    Omega_h::pseudo_invert(Omega_h::simplex_basis<3, 3>(vertex_coords));
+  auto xi = inverse_basis * (point - vertex_coords[0]);
+  return {1 - xi[0] - xi[1] - xi[2], xi[0], xi[1], xi[2]};
+}
+
 namespace detail
 {
+KOKKOS_INLINE_FUNCTION
+bool element_intersects_bbox(const Omega_h::Matrix<2, 3>& coords,
+                             const AABBox<2>& bbox)
+{
+  return triangle_intersects_bbox(coords, bbox);
+}
+KOKKOS_INLINE_FUNCTION
+bool element_intersects_bbox(const Omega_h::Matrix<3, 4>& coords,
+                             const AABBox<3>& bbox)
+{
+  return tetrahedron_intersects_bbox(coords, bbox);
+}
 /**
- *  Functor for constructing the mapping from grid cells to intersecting
- * triangles. Each row of the resulting CSR structure represents a grid cell and
- * each row entry corresponds to an ID of an element that intersects that grid
- * cell.
- * \Warning since this works on Omega_h meshes, we currently assume each element
- * is a 2D simplex (triangle)
- * \Warning since this uses Omega_h data which is only available in the
- * "Default" Execution space, the should not be used in an alternative EXE space
+ * Functor that visits every grid cell that intersects a simplex element. Only
+ * the cells that overlap the bounding box of the element (padded by one cell
+ * to account for round off in the cell index computation) are tested, so the
+ * work per element is proportional to the number of cells it covers.
  */
-struct GridTriIntersectionFunctor
+template <int DIM>
+struct GridElementIntersectionFunctor
 {
-  GridTriIntersectionFunctor(Omega_h::Mesh& mesh, Kokkos::View<UniformGrid[1]> grid)
-    : mesh_(mesh),
-      tris2verts_(mesh_.ask_elem_verts()),
-      coords_(mesh_.coords()),
+  GridElementIntersectionFunctor(Omega_h::Reals coords,
+                                 Omega_h::LOs ents2verts,
+                                 Kokkos::View<BasicUniformGrid<DIM>[1]> grid)
+    : ents2verts_(ents2verts),
+      coords_(coords),
       grid_(grid),
-      nelems_(mesh_.nelems())
+      nelems_(ents2verts.size() / (DIM + 1))
   {
-    if (mesh_.dim() != 2) {
-      std::cerr << "GridTriIntersection currently only developed for 2D "
-                   "triangular meshes\n";
-      std::terminate();
-    }
   }
-  /// Two-pass functor. On the first pass we set the number of grid/triangle
-  /// intersections. On the second pass we fill the CSR array with the indexes
-  /// to the triangles intersecting with the current grid cell (row)
-  KOKKOS_INLINE_FUNCTION
-  LO operator()(LO row, LO* fill) const
+  template <typename Op>
+  KOKKOS_INLINE_FUNCTION void operator()(LO elem_idx, const Op& op) const
   {
-    const auto grid_cell_bbox = grid_(0).GetCellBBOX(row);
-    LO num_intersections = 0;
-    // hierarchical parallel may make be very beneficial here...
-    for (LO elem_idx = 0; elem_idx < nelems_; ++elem_idx) {
-      const auto elem_tri2verts = Omega_h::gather_verts<3>(tris2verts_, elem_idx);
-      // 2d mesh with 2d coords, but 3 triangles
-      const auto vertex_coords = Omega_h::gather_vectors<3, 2>(coords_, elem_tri2verts);
-      if (triangle_intersects_bbox(vertex_coords, grid_cell_bbox)) {
-        if (fill) {
-          fill[num_intersections] = elem_idx;
+    const auto elem_verts =
+      Omega_h::gather_verts<DIM + 1>(ents2verts_, elem_idx);
+    const auto vertex_coords =
+      Omega_h::gather_vectors<DIM + 1, DIM>(coords_, elem_verts);
+    const auto bbox = simplex_bbox<DIM>(vertex_coords);
+    const auto& grid = grid_(0);
+    Omega_h::Vector<DIM> lower;
+    Omega_h::Vector<DIM> upper;
+    for (int i = 0; i < DIM; ++i) {
+      lower[i] = bbox.center[i] - bbox.half_width[i];
+      upper[i] = bbox.center[i] + bbox.half_width[i];
+    }
+    const auto min_cell = grid.GetDimensionedIndex(grid.ClosestCellID(lower));
+    const auto max_cell = grid.GetDimensionedIndex(grid.ClosestCellID(upper));
+    std::array<LO, DIM> first;
+    std::array<LO, DIM> last;
+    for (int i = 0; i < DIM; ++i) {
+      // dimensioned indexes are in the reverse order of the coordinates
+      const LO ndivisions = grid.divisions[DIM - (i + 1)];
+      first[i] = (min_cell[i] > 0) ? min_cell[i] - 1 : 0;
+      last[i] = (max_cell[i] < ndivisions - 1) ? max_cell[i] + 1 : max_cell[i];
+    }
+    auto index = first;
+    while (true) {
+      const auto cell = grid.GetCellIndex(index);
+      if (element_intersects_bbox(vertex_coords, grid.GetCellBBOX(cell))) {
+        op(cell, elem_idx);
+      }
+      // the last index varies fastest so cells are visited in order
+      int i = DIM - 1;
+      for (; i >= 0; --i) {
+        if (++index[i] <= last[i]) {
+          break;
         }
-        ++num_intersections;
+        index[i] = first[i];
+      }
+      if (i < 0) {
+        break;
       }
     }
-    return num_intersections;
   }
 
 private:
-  Omega_h::Mesh& mesh_;
-  Omega_h::LOs tris2verts_;
+  Omega_h::LOs ents2verts_;
   Omega_h::Reals coords_;
-  Kokkos::View<UniformGrid[1]> grid_;
+  Kokkos::View<BasicUniformGrid<DIM>[1]> grid_;
 public:
   LO nelems_;
 };
 
+template <int DIM>
+std::array<LO, DIM> automatic_grid_divisions(
+  const std::array<Real, DIM>& lengths, LO nelems)
+{
+  // a simplex with the volume of a grid cell overlaps a few cells, so about
+  // one cell per element keeps the number of candidates per cell small
+  // without the grid dominating the memory use
+  const Real num_cells = std::max(nelems, 1);
+  std::array<LO, DIM> divisions;
+  Real volume = 1;
+  int num_divided = 0;
+  int last_divided = -1;
+  for (int i = 0; i < DIM; ++i) {
+    divisions[i] = 1;
+    // degenerate directions of the bounding box are not divided
+    if (lengths[i] > 0) {
+      volume *= lengths[i];
+      ++num_divided;
+      last_divided = i;
+    }
+  }
+  if (num_divided == 0) {
+    return divisions;
+  }
+  // edge length of a cube with the volume of a single cell
+  const Real cell_length = std::pow(volume / num_cells, 1.0 / num_divided);
+  LO divided_cells = 1;
+  for (int i = 0; i < last_divided; ++i) {
+    if (lengths[i] > 0) {
+      divisions[i] =
+        std::max(static_cast<LO>(std::round(lengths[i] / cell_length)), 1);
+      divided_cells *= divisions[i];
+    }
+  }
+  divisions[last_divided] =
+    std::max(static_cast<LO>(std::ceil(num_cells / divided_cells)), 1);
+  return divisions;
+}
+template std::array<LO, 2> automatic_grid_divisions<2>(
+  const std::array<Real, 2>&, LO);
+template std::array<LO, 3> automatic_grid_divisions<3>(
+  const std::array<Real, 3>&, LO);
+
+std::array<LO, 2> automatic_grid_divisions(Real width, Real height,
+                                           LO nelems)
+{
+  return automatic_grid_divisions<2>({width, height}, nelems);
+}
+
+template <int DIM>
+InverseBases<DIM> construct_inverse_bases(Omega_h::Reals coords,
+                                          Omega_h::LOs ents2verts)
+{
+  const LO nelems = ents2verts.size() / (DIM + 1);
+  InverseBases<DIM> bases(
+    Kokkos::ViewAllocateWithoutInitializing("inverse bases"), nelems);
+  Kokkos::parallel_for(
+    "construct inverse bases", nelems, KOKKOS_LAMBDA(LO elem) {
+      const auto elem_verts = Omega_h::gather_verts<DIM + 1>(ents2verts, elem);
+      const auto vertex_coords =
+        Omega_h::gather_vectors<DIM + 1, DIM>(coords, elem_verts);
+      const auto inverse_basis =
+        Omega_h::pseudo_invert(Omega_h::simplex_basis<DIM, DIM>(vertex_coords));
+      // xi = inverse_basis * (point - vertex_coords[0])
+      for (int k = 0; k < DIM; ++k) {
+        Real constant = 0;
+        for (int j = 0; j < DIM; ++j) {
+          const Real a = inverse_basis(k, j);
+          bases(elem, (DIM + 1) * k + j) = a;
+          constant -= a * vertex_coords[0][j];
+        }
+        bases(elem, (DIM + 1) * k + DIM) = constant;
+      }
+    });
+  return bases;
+}
+template InverseBases<2> construct_inverse_bases<2>(Omega_h::Reals,
+                                                    Omega_h::LOs);
+template InverseBases<3> construct_inverse_bases<3>(Omega_h::Reals,
+                                                    Omega_h::LOs);
+
+template <int DIM>
+Omega_h::LOs construct_element_neighbors(Omega_h::LOs ents2verts,
+                                         Omega_h::Graph dual)
+{
+  const LO nelems = ents2verts.size() / (DIM + 1);
+  Omega_h::Write<LO> neighbors(nelems * (DIM + 1), -1, "element neighbors");
+  auto offsets = dual.a2ab;
+  auto adjacent = dual.ab2b;
+  Kokkos::parallel_for(
+    "construct element neighbors", nelems, KOKKOS_LAMBDA(LO elem) {
+      const auto verts = Omega_h::gather_verts<DIM + 1>(ents2verts, elem);
+      for (auto i = offsets[elem]; i < offsets[elem + 1]; ++i) {
+        const auto other = adjacent[i];
+        const auto other_verts =
+          Omega_h::gather_verts<DIM + 1>(ents2verts, other);
+        // the neighbor shares every vertex except the one opposite of the
+        // shared face
+        for (int k = 0; k < DIM + 1; ++k) {
+          bool shared = false;
+          for (int j = 0; j < DIM + 1; ++j) {
+            shared = shared || (other_verts[j] == verts[k]);
+          }
+          if (!shared) {
+            neighbors[(DIM + 1) * elem + k] = other;
+            break;
+          }
+        }
+      }
+    });
+  return neighbors;
+}
+
+template <int DIM>
+Omega_h::LOs construct_element_neighbors(Omega_h::LOs ents2verts)
+{
+  const auto ents2verts_h = Omega_h::HostRead<LO>(ents2verts);
+  const LO nelems = ents2verts_h.size() / (DIM + 1);
+  Omega_h::HostWrite<LO> neighbors(nelems * (DIM + 1), "element neighbors");
+  // first element seen with each face, keyed by the sorted face vertices
+  std::map<std::array<LO, DIM>, LO> faces;
+  for (LO elem = 0; elem < nelems; ++elem) {
+    for (int k = 0; k < DIM + 1; ++k) {
+      neighbors[(DIM + 1) * elem + k] = -1;
+      std::array<LO, DIM> face;
+      for (int j = 0, n = 0; j < DIM + 1; ++j) {
+        if (j != k) {
+          face[n++] = ents2verts_h[(DIM + 1) * elem + j];
+        }
+      }
+      std::sort(face.begin(), face.end());
+      const auto [it, inserted] = faces.emplace(face, (DIM + 1) * elem + k);
+      if (!inserted) {
+        neighbors[(DIM + 1) * elem + k] = it->second / (DIM + 1);
+        neighbors[it->second] = elem;
+        faces.erase(it);
+      }
+    }
+  }
+  return Omega_h::LOs(neighbors.write());
+}
+template Omega_h::LOs construct_element_neighbors<2>(Omega_h::LOs,
+                                                     Omega_h::Graph);
+template Omega_h::LOs construct_element_neighbors<3>(Omega_h::LOs,
+                                                     Omega_h::Graph);
+template Omega_h::LOs construct_element_neighbors<2>(Omega_h::LOs);
+template Omega_h::LOs construct_element_neighbors<3>(Omega_h::LOs);
+
 // num_grid_cells should be result of grid.GetNumCells(), take as argument to avoid extra copy
 // of grid from gpu to cpu
+template <int DIM>
+Kokkos::Crs<LO, Kokkos::DefaultExecutionSpace, void, LO>
+construct_intersection_map(Omega_h::Mesh& mesh,
+                           Kokkos::View<BasicUniformGrid<DIM>[1]> grid,
+                           int num_grid_cells)
+{
+  if (mesh.dim() != DIM) {
+    std::cerr << "GridElementIntersection requires a " << DIM
+              << "D simplex mesh\n";
+    std::terminate();
+  }
+  return construct_intersection_map<DIM>(mesh.coords(), mesh.ask_elem_verts(),
+                                         grid, num_grid_cells);
+}
+/// Each row of the resulting CSR structure represents a grid cell and
+/// each row entry corresponds to an ID of an element that intersects that grid
+/// cell. The map is built with a count/scan/fill over the elements and the
+/// entries of each row are in ascending order.
+template <int DIM>
 Kokkos::Crs<LO, Kokkos::DefaultExecutionSpace, void, LO>
-construct_intersection_map(Omega_h::Mesh& mesh, Kokkos::View<UniformGrid[1]> grid, int num_grid_cells)
+construct_intersection_map(Omega_h::Reals coords, Omega_h::LOs ents2verts,
+                           Kokkos::View<BasicUniformGrid<DIM>[1]> grid,
+                           int num_grid_cells)
 {
-  Kokkos::Crs<LO, Kokkos::DefaultExecutionSpace, void, LO> intersection_map{};
-  auto f = detail::GridTriIntersectionFunctor{mesh, grid};
-  Kokkos::count_and_fill_crs(intersection_map, num_grid_cells, f);
+  using CrsT = Kokkos::Crs<LO, Kokkos::DefaultExecutionSpace, void, LO>;
+  auto f = detail::GridElementIntersectionFunctor<DIM>{coords, ents2verts, grid};
+  // count the number of elements intersecting each grid cell
+  typename CrsT::row_map_type row_map("row map", num_grid_cells + 1);
+  Kokkos::parallel_for(
+    "count grid/element intersections", f.nelems_, KOKKOS_LAMBDA(LO elem) {
+      f(elem, [&](LO cell, LO) { Kokkos::atomic_increment(&row_map(cell)); });
+    });
+  Kokkos::parallel_scan(
+    num_grid_cells + 1, KOKKOS_LAMBDA(LO i, LO & update, bool final) {
+      const auto count = row_map(i);
+      if (final) {
+        row_map(i) = update;
+      }
+      update += count;
+    });
+  LO num_entries = 0;
+  Kokkos::deep_copy(num_entries,
+                    Kokkos::subview(row_map, num_grid_cells));
+  typename CrsT::entries_type entries(
+    Kokkos::ViewAllocateWithoutInitializing("entries"), num_entries);
+  Kokkos::View<LO*> fill_position("fill position", num_grid_cells);
+  Kokkos::parallel_for(
+    "fill grid/element intersections", f.nelems_, KOKKOS_LAMBDA(LO elem) {
+      f(elem, [&](LO cell, LO elem_idx) {
+        const auto pos = Kokkos::atomic_fetch_add(&fill_position(cell), 1);
+        entries(row_map(cell) + pos) = elem_idx;
+      });
+    });
+  // the fill order is nondeterministic. Sort each row so the search returns
+  // the same element for points on shared edges regardless of the backend
+  Kokkos::parallel_for(
+    num_grid_cells, KOKKOS_LAMBDA(LO row) {
+      for (LO i = row_map(row) + 1; i < row_map(row + 1); ++i) {
+        const auto val = entries(i);
+        LO j = i;
+        for (; j > row_map(row) && entries(j - 1) > val; --j) {
+          entries(j) = entries(j - 1);
+        }
+        entries(j) = val;
+      }
+    });
+  CrsT intersection_map{};
+  intersection_map.row_map = row_map;
+  intersection_map.entries = entries;
   return intersection_map;
 }
-} // namespace detail
+template Kokkos::Crs<LO, Kokkos::DefaultExecutionSpace, void, LO>
+construct_intersection_map<2>(Omega_h::Mesh&, Kokkos::View<UniformGrid[1]>,
+                              int);
+template Kokkos::Crs<LO, Kokkos::DefaultExecutionSpace, void, LO>
+construct_intersection_map<3>(Omega_h::Mesh&, Kokkos::View<UniformGrid3D[1]>,
+                              int);
+template Kokkos::Crs<LO, Kokkos::DefaultExecutionSpace, void, LO>
+construct_intersection_map<2>(Omega_h::Reals, Omega_h::LOs,
+                              Kokkos::View<UniformGrid[1]>, int);
+template Kokkos::Crs<LO, Kokkos::DefaultExecutionSpace, void, LO>
+construct_intersection_map<3>(Omega_h::Reals, Omega_h::LOs,
+                              Kokkos::View<UniformGrid3D[1]>, int);
 
-KOKKOS_FUNCTION
-Omega_h::Vector<3> barycentric_from_global(
-  const Omega_h::Vector<2>& point, const Omega_h::Matrix<2, 3>& vertex_coords)
+/// barycentric coordinates of the closest point on the triangle to the input
+/// point. The squared distance to the closest point is returned in dist2
+KOKKOS_INLINE_FUNCTION
+Omega_h::Vector<3> closest_point_barycentric(
+  const Omega_h::Vector<2>& point, const Omega_h::Matrix<2, 3>& vertex_coords,
+  Real& dist2)
 {
-  const auto inverse_basis =
-    Omega_h::pseudo_invert(Omega_h::simplex_basis<2, 2>(vertex_coords));
-  auto xi = inverse_basis * (point - vertex_coords[0]);
-  // note omega_h form_barycentric is currently broken.
-  // see https://github.com/sandialabs/omega_h/issues/389
-  return {1 - xi[0] - xi[1], xi[0], xi[1]};
+  const auto xi = barycentric_from_global(point, vertex_coords);
+  if (Omega_h::is_barycentric_inside(xi, fuzz)) {
+    dist2 = 0;
+    return xi;
+  }
+  // outside the triangle the closest point lies on one of the edges
+  Omega_h::Vector<3> closest{0, 0, 0};
+  dist2 = std::numeric_limits<Real>::max();
+  for (int e = 0; e < 3; ++e) {
+    const auto& a = vertex_coords[e];
+    const auto& b = vertex_coords[(e + 1) % 3];
+    const Real abx = b[0] - a[0];
+    const Real aby = b[1] - a[1];
+    const Real len2 = abx * abx + aby * aby;
+    Real t = 0;
+    if (len2 > 0) {
+      t = ((point[0] - a[0]) * abx + (point[1] - a[1]) * aby) / len2;
+      t = (t < 0) ? 0 : ((t > 1) ? 1 : t);
+    }
+    const Real dx = point[0] - (a[0] + t * abx);
+    const Real dy = point[1] - (a[1] + t * aby);
+    const Real edge_dist2 = dx * dx + dy * dy;
+    if (edge_dist2 < dist2) {
+      dist2 = edge_dist2;
+      closest = Omega_h::Vector<3>{0, 0, 0};
+      closest[e] = 1 - t;
+      closest[(e + 1) % 3] = t;
+    }
+  }
+  return closest;
+}
+/// barycentric coordinates (with respect to a, b, c) of the closest point on
+/// the triangle to the input point
+// Ericson, Christer. Real-Time Collision Detection. Section 5.1.5
+KOKKOS_INLINE_FUNCTION
+Omega_h::Vector<3> closest_point_on_triangle(const Omega_h::Vector<3>& p,
+                                             const Omega_h::Vector<3>& a,
+                                             const Omega_h::Vector<3>& b,
+                                             const Omega_h::Vector<3>& c)
+{
+  const auto ab = b - a;
+  const auto ac = c - a;
+  const auto ap = p - a;
+  const Real d1 = ab * ap;
+  const Real d2 = ac * ap;
+  if (d1 <= 0 && d2 <= 0) {
+    return {1, 0, 0};
+  }
+  const auto bp = p - b;
+  const Real d3 = ab * bp;
+  const Real d4 = ac * bp;
+  if (d3 >= 0 && d4 <= d3) {
+    return {0, 1, 0};
+  }
+  const Real vc = d1 * d4 - d3 * d2;
+  if (vc <= 0 && d1 >= 0 && d3 <= 0) {
+    const Real v = d1 / (d1 - d3);
+    return {1 - v, v, 0};
+  }
+  const auto cp = p - c;
+  const Real d5 = ab * cp;
+  const Real d6 = ac * cp;
+  if (d6 >= 0 && d5 <= d6) {
+    return {0, 0, 1};
+  }
+  const Real vb = d5 * d2 - d1 * d6;
+  if (vb <= 0 && d2 >= 0 && d6 <= 0) {
+    const Real w = d2 / (d2 - d6);
+    return {1 - w, 0, w};
+  }
+  const Real va = d3 * d6 - d5 * d4;
+  if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) {
+    const Real w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+    return {0, 1 - w, w};
+  }
+  const Real denom = 1 / (va + vb + vc);
+  const Real v = vb * denom;
+  const Real w = vc * denom;
+  return {1 - v - w, v, w};
+}
+/// barycentric coordinates of the closest point on the tetrahedron to the
+/// input point. The squared distance to the closest point is returned in dist2
+KOKKOS_INLINE_FUNCTION
+Omega_h::Vector<4> closest_point_barycentric(
+  const Omega_h::Vector<3>& point, const Omega_h::Matrix<3, 4>& vertex_coords,
+  Real& dist2)
+{
+  const auto xi = barycentric_from_global(point, vertex_coords);
+  if (Omega_h::is_barycentric_inside(xi, fuzz)) {
+    dist2 = 0;
+    return xi;
+  }
+  // outside the tetrahedron the closest point lies on one of the faces
+  Omega_h::Vector<4> closest{0, 0, 0, 0};
+  dist2 = std::numeric_limits<Real>::max();
+  for (int face = 0; face < 4; ++face) {
+    const int v[3] = {(face + 1) % 4, (face + 2) % 4, (face + 3) % 4};
+    const auto face_xi =
+      closest_point_on_triangle(point, vertex_coords[v[0]],
+                                vertex_coords[v[1]], vertex_coords[v[2]]);
+    const auto face_point = vertex_coords[v[0]] * face_xi[0] +
+                            vertex_coords[v[1]] * face_xi[1] +
+                            vertex_coords[v[2]] * face_xi[2];
+    const Real face_dist2 = Omega_h::norm_squared(point - face_point);
+    if (face_dist2 < dist2) {
+      dist2 = face_dist2;
+      closest = Omega_h::Vector<4>{0, 0, 0, 0};
+      for (int i = 0; i < 3; ++i) {
+        closest[v[i]] = face_xi[i];
+      }
+    }
+  }
+  return closest;
+}
+template <int dim>
+KOKKOS_INLINE_FUNCTION Real bbox_distance2(const Omega_h::Vector<dim>& point,
+                                           const AABBox<dim>& bbox)
+{
+  Real dist2 = 0;
+  for (int i = 0; i < dim; ++i) {
+    const Real d = std::abs(point[i] - bbox.center[i]) - bbox.half_width[i];
+    if (d > 0) {
+      dist2 += d * d;
+    }
+  }
+  return dist2;
 }
+} // namespace detail
 
 template <int n,  typename Op>
 OMEGA_H_INLINE double myreduce(const Omega_h::Vector<n> & x, Op op) OMEGA_H_NOEXCEPT {
@@ -227,57 +699,495 @@ OMEGA_H_INLINE double myreduce(const Omega_h::Vector<n> & x, Op op) OMEGA_H_NOEX
   return out;
 }         
 
-Kokkos::View<GridPointSearch::Result*> GridPointSearch::operator()(Kokkos::View<Real*[dim] > points) const
+template <int DIM>
+Kokkos::View<LO*> BasicGridPointSearch<DIM>::SpatialOrder(
+  Kokkos::View<Real* [dim]> points) const
 {
-  static_assert(dim == 2, "point search assumes dim==2");
-  Kokkos::View<GridPointSearch::Result*> results("point search result", points.extent(0));
+  const LO npoints = points.extent(0);
+  // the point index is stored in the low bits of the sort key and the
+  // Morton code uses the remaining bits
+  int index_bits = 1;
+  while (index_bits < 63 &&
+         (std::uint64_t{1} << index_bits) < static_cast<std::uint64_t>(npoints)) {
+    ++index_bits;
+  }
+  const int bits = std::min((64 - index_bits) / dim, 31);
+  const std::uint64_t index_mask = (std::uint64_t{1} << index_bits) - 1;
+  auto grid = grid_;
+  auto quadtree = quadtree_;
+  const bool use_quadtree = quadtree_.extent(0) > 0;
+  Kokkos::View<std::uint64_t*> keys(
+    Kokkos::ViewAllocateWithoutInitializing("morton keys"), npoints);
+  Kokkos::parallel_for(
+    "morton keys", npoints, KOKKOS_LAMBDA(LO p) {
+      const Real cells = static_cast<Real>(std::uint64_t{1} << bits);
+      std::array<std::uint32_t, dim> index;
+      for (int i = 0; i < dim; ++i) {
+        const Real lower =
+          use_quadtree
+            ? quadtree(0).bbox.center[i] - quadtree(0).bbox.half_width[i]
+            : grid(0).bot_left[i];
+        const Real length = use_quadtree ? 2 * quadtree(0).bbox.half_width[i]
+                                         : grid(0).edge_length[i];
+        Real t = (length > 0) ? (points(p, i) - lower) / length * cells : 0;
+        t = (t < 0) ? 0 : ((t > cells - 1) ? cells - 1 : t);
+        index[i] = static_cast<std::uint32_t>(t);
+      }
+      keys(p) = (detail::morton_code<dim>(index, bits) << index_bits) |
+                static_cast<std::uint64_t>(p);
+    });
+  Kokkos::sort(keys);
+  Kokkos::View<LO*> permutation(
+    Kokkos::ViewAllocateWithoutInitializing("spatial order"), npoints);
+  Kokkos::parallel_for(
+    npoints, KOKKOS_LAMBDA(LO i) {
+      permutation(i) = static_cast<LO>(keys(i) & index_mask);
+    });
+  return permutation;
+}
+
+template <int DIM>
+auto BasicGridPointSearch<DIM>::operator()(Kokkos::View<Real* [dim]> points,
+                                           QueryOrder order) const
+  -> Kokkos::View<Result*>
+{
+  Kokkos::View<Result*> results("point search result", points.extent(0));
+  if (order == QueryOrder::Spatial && points.extent(0) > 1) {
+    const auto permutation = SpatialOrder(points);
+    Kokkos::View<Real* [dim]> sorted_points(
+      Kokkos::ViewAllocateWithoutInitializing("sorted points"),
+      points.extent(0));
+    Kokkos::parallel_for(
+      points.extent(0), KOKKOS_LAMBDA(LO i) {
+        for (int d = 0; d < dim; ++d) {
+          sorted_points(i, d) = points(permutation(i), d);
+        }
+      });
+    auto sorted_results = (*this)(sorted_points, QueryOrder::Input);
+    Kokkos::parallel_for(
+      points.extent(0),
+      KOKKOS_LAMBDA(LO i) { results(permutation(i)) = sorted_results(i); });
+    return results;
+  }
   auto num_rows = candidate_map_.numRows();
   // needed so that we don't capture this ptr which will be memory error on cuda
   auto grid = grid_; 
+  auto quadtree = quadtree_;
+  const bool use_quadtree = quadtree_.extent(0) > 0;
   auto candidate_map = candidate_map_;
   auto tris2verts = tris2verts_;
   auto coords = coords_;
+  auto inverse_bases = inverse_bases_;
   Kokkos::parallel_for(points.extent(0), KOKKOS_LAMBDA(int p) {
-    Omega_h::Vector<2> point(std::initializer_list<double>{points(p,0), points(p,1)});
-    auto cell_id = grid(0).ClosestCellID(point);
+    Omega_h::Vector<dim> point;
+    for (int i = 0; i < dim; ++i) {
+      point[i] = points(p, i);
+    }
+    auto cell_id = use_quadtree ? detail::quadtree_leaf(quadtree, point)
+                                : grid(0).ClosestCellID(point);
     assert(cell_id < num_rows && cell_id >= 0);
     auto candidates_begin = candidate_map.row_map(cell_id);
     auto candidates_end = candidate_map.row_map(cell_id + 1);
     bool found = false;
-    // create array that's size of number of candidates x num coords to store
-    // parametric inversion
     for (auto i = candidates_begin; i < candidates_end; ++i) {
-     auto elem_tri2verts =
-        Omega_h::gather_verts<3>(tris2verts, candidate_map.entries(i));
-      // 2d mesh with 2d coords, but 3 triangles
-     auto vertex_coords = Omega_h::gather_vectors<3, 2>(coords, elem_tri2verts);
-     auto parametric_coords = barycentric_from_global(point, vertex_coords);
+      // the precomputed affine map avoids gathering the vertex coordinates
+      // and inverting the basis of every candidate
+      auto parametric_coords = detail::barycentric_from_bases(
+        inverse_bases, candidate_map.entries(i), point);
       if (Omega_h::is_barycentric_inside(parametric_coords, fuzz)) {
-        results(p) = GridPointSearch::Result{candidate_map.entries(i), parametric_coords};
+        results(p) = Result{candidate_map.entries(i), parametric_coords};
         found = true;
         break;
       }
     }
     if(!found)
     {
-      results(p) = GridPointSearch::Result{-1,{0,0,0}};
+      // the point is outside of the mesh. Find the closest element by
+      // searching outward from the cell containing the point
+      Real best_dist2 = std::numeric_limits<Real>::max();
+      LO best_elem = -1;
+      Omega_h::Vector<dim + 1> best_coords;
+      for (int i = 0; i < dim + 1; ++i) {
+        best_coords[i] = 0;
+      }
+      auto test_candidates = [&](LO row) {
+        for (auto i = candidate_map.row_map(row);
+             i < candidate_map.row_map(row + 1); ++i) {
+          const auto elem = candidate_map.entries(i);
+          const auto elem_verts =
+            Omega_h::gather_verts<dim + 1>(tris2verts, elem);
+          const auto vertex_coords =
+            Omega_h::gather_vectors<dim + 1, dim>(coords, elem_verts);
+          Real dist2 = 0;
+          const auto closest =
+            detail::closest_point_barycentric(point, vertex_coords, dist2);
+          // lowest element id breaks ties so results are deterministic
+          if (dist2 < best_dist2 ||
+              (dist2 == best_dist2 && elem < best_elem)) {
+            best_dist2 = dist2;
+            best_elem = elem;
+            best_coords = closest;
+          }
+        }
+      };
+      if (use_quadtree) {
+        // depth first traversal that skips nodes farther than the best
+        // element found so far
+        constexpr int num_children = 1 << dim;
+        LO stack[num_children * max_quadtree_depth + 1];
+        int stack_size = 0;
+        stack[stack_size++] = 0;
+        while (stack_size > 0) {
+          const auto& node = quadtree(stack[--stack_size]);
+          if (detail::bbox_distance2(point, node.bbox) > best_dist2) {
+            continue;
+          }
+          if (node.leaf_id >= 0) {
+            test_candidates(node.leaf_id);
+          } else {
+            for (int child = 0; child < num_children; ++child) {
+              stack[stack_size++] = node.first_child + child;
+            }
+          }
+        }
+      } else {
+        const auto& g = grid(0);
+        // dimensioned indexes are in the reverse order of the coordinates
+        const auto center_cell = g.GetDimensionedIndex(cell_id);
+        Real cell_size = std::numeric_limits<Real>::max();
+        LO max_ring = 0;
+        for (int i = 0; i < dim; ++i) {
+          const Real cell_length = g.edge_length[i] / g.divisions[i];
+          cell_size = (cell_length < cell_size) ? cell_length : cell_size;
+          max_ring = (g.divisions[i] > max_ring) ? g.divisions[i] : max_ring;
+        }
+        for (LO ring = 0; ring <= max_ring; ++ring) {
+          // every cell in this ring is at least (ring-1) cells away
+          const Real ring_dist = (ring - 1) * cell_size;
+          if (ring > 1 && ring_dist * ring_dist >= best_dist2) {
+            break;
+          }
+          // iterate over the outer indexes of the cube of cells around the
+          // center. Unless one of them is on the surface of the cube, only
+          // the two ends of the innermost (x) index are in the ring
+          std::array<LO, dim> index;
+          for (int i = 0; i < dim; ++i) {
+            index[i] = center_cell[i] - ring;
+          }
+          while (true) {
+            bool in_grid = true;
+            bool on_surface = (ring == 0);
+            for (int i = 0; i < dim - 1; ++i) {
+              in_grid = in_grid && index[i] >= 0 &&
+                        index[i] < g.divisions[dim - (i + 1)];
+              on_surface = on_surface || index[i] == center_cell[i] - ring ||
+                           index[i] == center_cell[i] + ring;
+            }
+            if (in_grid) {
+              const LO step = on_surface ? 1 : 2 * ring;
+              for (LO j = center_cell[dim - 1] - ring;
+                   j <= center_cell[dim - 1] + ring; j += step) {
+                if (j >= 0 && j < g.divisions[0]) {
+                  index[dim - 1] = j;
+                  test_candidates(g.GetCellIndex(index));
+                }
+              }
+            }
+            int i = dim - 2;
+            for (; i >= 0; --i) {
+              if (++index[i] <= center_cell[i] + ring) {
+                break;
+              }
+              index[i] = center_cell[i] - ring;
+            }
+            if (i < 0) {
+              break;
+            }
+          }
+        }
+      }
+      // no element is tested when the mesh has no elements
+      results(p) = Result{
+        (best_elem >= 0) ? -(best_elem + 1) : Result::not_found, best_coords};
     }
   });
 
   return results;
 }
 
-GridPointSearch::GridPointSearch(Omega_h::Mesh& mesh, LO Nx, LO Ny)
+template <int DIM>
+auto BasicGridPointSearch<DIM>::operator()(
+  Kokkos::View<Real* [dim]> points, Kokkos::View<const Result*> hints) const
+  -> Kokkos::View<Result*>
 {
-  auto mesh_bbox = Omega_h::get_bounding_box<2>(&mesh);
+  PCMS_ALWAYS_ASSERT(hints.extent(0) == points.extent(0));
+  const LO npoints = points.extent(0);
+  Kokkos::View<Result*> results("point search result", npoints);
+  Kokkos::View<bool*> walked(
+    Kokkos::ViewAllocateWithoutInitializing("walked"), npoints);
+  auto inverse_bases = inverse_bases_;
+  auto neighbors = GetElementNeighbors();
+  const LO nelems = inverse_bases_.extent(0);
+  LO num_failed = 0;
+  Kokkos::parallel_reduce(
+    "walk from hints", npoints,
+    KOKKOS_LAMBDA(LO p, LO & failed) {
+      Omega_h::Vector<dim> point;
+      for (int i = 0; i < dim; ++i) {
+        point[i] = points(p, i);
+      }
+      LO elem = hints(p).ElementId();
+      bool found = false;
+      for (LO step = 0; step < max_walk_steps && elem >= 0 && elem < nelems;
+           ++step) {
+        const auto xi =
+          detail::barycentric_from_bases(inverse_bases, elem, point);
+        if (Omega_h::is_barycentric_inside(xi, fuzz)) {
+          results(p) = Result{elem, xi};
+          found = true;
+          break;
+        }
+        // the point is on the far side of the face opposite of the most
+        // negative coordinate
+        int exit_face = 0;
+        for (int k = 1; k < dim + 1; ++k) {
+          exit_face = (xi[k] < xi[exit_face]) ? k : exit_face;
+        }
+        elem = neighbors[(dim + 1) * elem + exit_face];
+      }
+      walked(p) = found;
+      failed += found ? 0 : 1;
+    },
+    num_failed);
+  if (num_failed > 0) {
+    // the points that could not be reached by walking are searched with
+    // the grid
+    Kokkos::View<LO*> failed_ids(
+      Kokkos::ViewAllocateWithoutInitializing("failed ids"), num_failed);
+    Kokkos::parallel_scan(
+      npoints, KOKKOS_LAMBDA(LO p, LO & offset, bool final) {
+        if (!walked(p)) {
+          if (final) {
+            failed_ids(offset) = p;
+          }
+          ++offset;
+        }
+      });
+    Kokkos::View<Real* [dim]> failed_points(
+      Kokkos::ViewAllocateWithoutInitializing("failed points"), num_failed);
+    Kokkos::parallel_for(
+      num_failed, KOKKOS_LAMBDA(LO i) {
+        for (int d = 0; d < dim; ++d) {
+          failed_points(i, d) = points(failed_ids(i), d);
+        }
+      });
+    auto failed_results = (*this)(failed_points);
+    Kokkos::parallel_for(
+      num_failed,
+      KOKKOS_LAMBDA(LO i) { results(failed_ids(i)) = failed_results(i); });
+  }
+  return results;
+}
+
+namespace
+{
+template <int dim>
+std::array<LO, dim> requested_divisions(LO Nx, LO Ny, LO Nz)
+{
+  const std::array<LO, 3> all{Nx, Ny, Nz};
+  std::array<LO, dim> divisions;
+  for (int i = 0; i < dim; ++i) {
+    divisions[i] = all[i];
+  }
+  return divisions;
+}
+} // namespace
+
+template <int DIM>
+BasicGridPointSearch<DIM>::BasicGridPointSearch(Omega_h::Mesh& mesh, LO Nx,
+                                                LO Ny, LO Nz)
+  : tris2verts_(mesh.ask_elem_verts()),
+    coords_(mesh.coords()),
+    inverse_bases_(detail::construct_inverse_bases<DIM>(coords_, tris2verts_))
+{
+  PCMS_ALWAYS_ASSERT(mesh.dim() == dim);
+  if (mesh.has_adj(dim, dim)) {
+    dual_ = mesh.ask_dual();
+  }
+  ConstructUniformGrid(Omega_h::get_bounding_box<dim>(&mesh),
+                       requested_divisions<dim>(Nx, Ny, Nz));
+}
+
+template <int DIM>
+BasicGridPointSearch<DIM>::BasicGridPointSearch(Omega_h::Reals coords,
+                                                Omega_h::LOs ents2verts,
+                                                LO Nx, LO Ny, LO Nz)
+  : tris2verts_(ents2verts),
+    coords_(coords),
+    inverse_bases_(detail::construct_inverse_bases<DIM>(coords_, tris2verts_))
+{
+  PCMS_ALWAYS_ASSERT(coords.size() % dim == 0);
+  PCMS_ALWAYS_ASSERT(ents2verts.size() % (dim + 1) == 0);
+  ConstructUniformGrid(Omega_h::find_bounding_box<dim>(coords),
+                       requested_divisions<dim>(Nx, Ny, Nz));
+}
+
+template <int DIM>
+BasicGridPointSearch<DIM>::BasicGridPointSearch(Omega_h::Mesh& mesh,
+                                                QuadtreeOptions options)
+  : tris2verts_(mesh.ask_elem_verts()),
+    coords_(mesh.coords()),
+    inverse_bases_(detail::construct_inverse_bases<DIM>(coords_, tris2verts_))
+{
+  PCMS_ALWAYS_ASSERT(mesh.dim() == dim);
+  if (mesh.has_adj(dim, dim)) {
+    dual_ = mesh.ask_dual();
+  }
+  ConstructQuadtree(Omega_h::get_bounding_box<dim>(&mesh), options);
+}
+
+template <int DIM>
+BasicGridPointSearch<DIM>::BasicGridPointSearch(Omega_h::Reals coords,
+                                                Omega_h::LOs ents2verts,
+                                                QuadtreeOptions options)
+  : tris2verts_(ents2verts),
+    coords_(coords),
+    inverse_bases_(detail::construct_inverse_bases<DIM>(coords_, tris2verts_))
+{
+  PCMS_ALWAYS_ASSERT(coords.size() % dim == 0);
+  PCMS_ALWAYS_ASSERT(ents2verts.size() % (dim + 1) == 0);
+  ConstructQuadtree(Omega_h::find_bounding_box<dim>(coords), options);
+}
+
+template <int DIM>
+const Omega_h::LOs& BasicGridPointSearch<DIM>::GetElementNeighbors() const
+{
+  std::call_once(element_neighbors_->constructed, [this]() {
+    element_neighbors_->neighbors =
+      dual_.a2ab.exists()
+        ? detail::construct_element_neighbors<DIM>(tris2verts_, dual_)
+        : detail::construct_element_neighbors<DIM>(tris2verts_);
+  });
+  return element_neighbors_->neighbors;
+}
+
+template <int DIM>
+void BasicGridPointSearch<DIM>::ConstructUniformGrid(
+  const Omega_h::BBox<dim>& bbox, std::array<LO, dim> divisions)
+{
+  std::array<Real, dim> lengths;
+  bool automatic = false;
+  for (int i = 0; i < dim; ++i) {
+    lengths[i] = bbox.max[i] - bbox.min[i];
+    automatic = automatic || divisions[i] <= 0;
+  }
+  if (automatic) {
+    divisions = detail::automatic_grid_divisions<dim>(
+      lengths, tris2verts_.size() / (dim + 1));
+  }
   auto grid_h = Kokkos::create_mirror_view(grid_);
-  grid_h(0) = UniformGrid{.edge_length = {mesh_bbox.max[0] - mesh_bbox.min[0],
-                           mesh_bbox.max[1] - mesh_bbox.min[1]},
-    .bot_left = {mesh_bbox.min[0], mesh_bbox.min[1]},
-    .divisions = {Nx, Ny}};
+  grid_h(0).edge_length = lengths;
+  grid_h(0).divisions = divisions;
+  for (int i = 0; i < dim; ++i) {
+    grid_h(0).bot_left[i] = bbox.min[i];
+  }
   Kokkos::deep_copy(grid_, grid_h);
-  candidate_map_ = detail::construct_intersection_map(mesh, grid_, grid_h(0).GetNumCells());
-  coords_ = mesh.coords();
-  tris2verts_ = mesh.ask_elem_verts();
+  candidate_map_ = detail::construct_intersection_map<dim>(
+    coords_, tris2verts_, grid_, grid_h(0).GetNumCells());
 }
+
+template <int DIM>
+void BasicGridPointSearch<DIM>::ConstructQuadtree(
+  const Omega_h::BBox<dim>& bbox, const QuadtreeOptions& options)
+{
+  PCMS_ALWAYS_ASSERT(options.max_elements_per_leaf > 0);
+  // the traversal for points outside of the mesh uses a fixed size stack
+  PCMS_ALWAYS_ASSERT(options.max_depth <= max_quadtree_depth);
+  // the tree is built breadth first on the host. Each node only tests the
+  // elements that intersect its parent
+  struct PendingNode
+  {
+    LO node;
+    LO depth;
+    std::vector<LO> elements;
+  };
+  constexpr int num_children = 1 << dim;
+  const auto coords = Omega_h::HostRead<Real>(coords_);
+  const auto ents2verts = Omega_h::HostRead<LO>(tris2verts_);
+  const LO nelems = ents2verts.size() / (dim + 1);
+  auto element_coords = [&](LO elem) {
+    Omega_h::Matrix<dim, dim + 1> vertex_coords;
+    for (int i = 0; i < dim + 1; ++i) {
+      const auto vert = ents2verts[(dim + 1) * elem + i];
+      for (int j = 0; j < dim; ++j) {
+        vertex_coords(j, i) = coords[dim * vert + j];
+      }
+    }
+    return vertex_coords;
+  };
+  std::vector<detail::BasicQuadtreeNode<dim>> nodes;
+  std::vector<LO> leaf_offsets{0};
+  std::vector<LO> leaf_elements;
+  AABBox<dim> root;
+  for (int i = 0; i < dim; ++i) {
+    root.center[i] = (bbox.max[i] + bbox.min[i]) / 2;
+    root.half_width[i] = (bbox.max[i] - bbox.min[i]) / 2;
+  }
+  nodes.push_back({root, -1, -1});
+  std::deque<PendingNode> pending;
+  pending.push_back({0, 0, std::vector<LO>(nelems)});
+  std::iota(pending.front().elements.begin(), pending.front().elements.end(),
+            0);
+  while (!pending.empty()) {
+    auto current = std::move(pending.front());
+    pending.pop_front();
+    if (static_cast<LO>(current.elements.size()) <=
+          options.max_elements_per_leaf ||
+        current.depth >= options.max_depth) {
+      nodes[current.node].leaf_id = leaf_offsets.size() - 1;
+      leaf_elements.insert(leaf_elements.end(), current.elements.begin(),
+                           current.elements.end());
+      leaf_offsets.push_back(leaf_elements.size());
+      continue;
+    }
+    const auto parent = nodes[current.node].bbox;
+    const LO first_child = nodes.size();
+    nodes[current.node].first_child = first_child;
+    for (int child_id = 0; child_id < num_children; ++child_id) {
+      AABBox<dim> child;
+      for (int i = 0; i < dim; ++i) {
+        const Real offset = ((child_id >> i) & 1) ? 0.5 : -0.5;
+        child.center[i] = parent.center[i] + offset * parent.half_width[i];
+        child.half_width[i] = parent.half_width[i] / 2;
+      }
+      nodes.push_back({child, -1, -1});
+      std::vector<LO> child_elements;
+      for (auto elem : current.elements) {
+        if (detail::element_intersects_bbox(element_coords(elem), child)) {
+          child_elements.push_back(elem);
+        }
+      }
+      pending.push_back(
+        {first_child + child_id, current.depth + 1, std::move(child_elements)});
+    }
+  }
+  quadtree_ = Kokkos::View<detail::BasicQuadtreeNode<dim>*>(
+    Kokkos::ViewAllocateWithoutInitializing("quadtree"), nodes.size());
+  Kokkos::deep_copy(
+    quadtree_, Kokkos::View<detail::BasicQuadtreeNode<dim>*, Kokkos::HostSpace>(
+                 nodes.data(), nodes.size()));
+  candidate_map_.row_map = typename CandidateMapT::row_map_type(
+    Kokkos::ViewAllocateWithoutInitializing("row map"), leaf_offsets.size());
+  Kokkos::deep_copy(candidate_map_.row_map,
+                    Kokkos::View<LO*, Kokkos::HostSpace>(leaf_offsets.data(),
+                                                         leaf_offsets.size()));
+  candidate_map_.entries = typename CandidateMapT::entries_type(
+    Kokkos::ViewAllocateWithoutInitializing("entries"), leaf_elements.size());
+  Kokkos::deep_copy(candidate_map_.entries,
+                    Kokkos::View<LO*, Kokkos::HostSpace>(leaf_elements.data(),
+                                                         leaf_elements.size()));
+}
+
+template class BasicGridPointSearch<2>;
+template class BasicGridPointSearch<3>;
 } // namespace pcms
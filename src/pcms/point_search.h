@@ -1,6 +1,10 @@
 #ifndef PCMS_COUPLING_POINT_SEARCH_H
 #define PCMS_COUPLING_POINT_SEARCH_H
 #include <unordered_map>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <Kokkos_Core.hpp>
 #include <Omega_h_mesh.hpp>
 #include "types.h"
@@ -16,44 +20,278 @@ namespace pcms
 // this function is in the public header for testing, but should not be directly
 // used
 namespace detail {
+template <int DIM>
 Kokkos::Crs<LO, Kokkos::DefaultExecutionSpace, void, LO>
-construct_intersection_map(Omega_h::Mesh& mesh, Kokkos::View<UniformGrid[1]> grid, int num_grid_cells);
+construct_intersection_map(Omega_h::Mesh& mesh,
+                           Kokkos::View<BasicUniformGrid<DIM>[1]> grid,
+                           int num_grid_cells);
+template <int DIM>
+Kokkos::Crs<LO, Kokkos::DefaultExecutionSpace, void, LO>
+construct_intersection_map(Omega_h::Reals coords, Omega_h::LOs ents2verts,
+                           Kokkos::View<BasicUniformGrid<DIM>[1]> grid,
+                           int num_grid_cells);
+/// number of grid divisions in each direction so that the grid has roughly
+/// one cell per element and the cells are close to square
+[[nodiscard]] std::array<LO, 2> automatic_grid_divisions(Real width,
+                                                         Real height,
+                                                         LO nelems);
+/// number of grid divisions in each direction so that the grid has roughly
+/// one cell per element and the cells are close to cubes. Directions with
+/// zero length are not divided.
+template <int DIM>
+[[nodiscard]] std::array<LO, DIM> automatic_grid_divisions(
+  const std::array<Real, DIM>& lengths, LO nelems);
+/// Coefficients of the affine map from global to parametric coordinates of
+/// each simplex stored as a structure of arrays (the element index is the
+/// contiguous dimension). For element e, the parametric coordinates of the
+/// point x are xi_k = sum_j b(e,(DIM+1)k+j) * x_j + b(e,(DIM+1)k+DIM) for
+/// k=0..DIM-1
+template <int DIM = 2>
+using InverseBases = Kokkos::View<Real* [DIM * (DIM + 1)], Kokkos::LayoutLeft>;
+template <int DIM = 2>
+[[nodiscard]] InverseBases<DIM> construct_inverse_bases(
+  Omega_h::Reals coords, Omega_h::LOs ents2verts);
+/// neighbor of each element across each of its faces with dim+1 entries per
+/// element. Entry k is the element across the face opposite of local vertex
+/// k, or -1 on the boundary of the mesh.
+template <int DIM = 2>
+[[nodiscard]] Omega_h::LOs construct_element_neighbors(Omega_h::LOs ents2verts,
+                                                       Omega_h::Graph dual);
+/// element neighbors of a mesh that is not stored as an Omega_h mesh. The
+/// shared faces are matched on the host.
+template <int DIM = 2>
+[[nodiscard]] Omega_h::LOs construct_element_neighbors(Omega_h::LOs ents2verts);
+/// barycentric coordinates of the point in the element using the precomputed
+/// inverse bases (InverseBases or a mirror of it)
+template <typename Bases, int dim>
+[[nodiscard]] KOKKOS_INLINE_FUNCTION Omega_h::Vector<dim + 1>
+barycentric_from_bases(const Bases& bases, LO elem,
+                       const Omega_h::Vector<dim>& point)
+{
+  Omega_h::Vector<dim + 1> xi;
+  xi[0] = 1;
+  for (int k = 0; k < dim; ++k) {
+    Real xik = bases(elem, (dim + 1) * k + dim);
+    for (int j = 0; j < dim; ++j) {
+      xik += bases(elem, (dim + 1) * k + j) * point[j];
+    }
+    xi[k + 1] = xik;
+    xi[0] -= xik;
+  }
+  return xi;
+}
+/// interleave the low bits of the index in each direction into a Morton
+/// code. The first direction is the least significant bit of each group.
+template <int dim>
+[[nodiscard]] KOKKOS_INLINE_FUNCTION std::uint64_t morton_code(
+  const std::array<std::uint32_t, dim>& index, int bits)
+{
+  std::uint64_t code = 0;
+  for (int b = bits - 1; b >= 0; --b) {
+    for (int i = dim - 1; i >= 0; --i) {
+      code = (code << 1) | ((index[i] >> b) & 1u);
+    }
+  }
+  return code;
+}
+/// node of a quadtree (octree in 3D) stored as a flat array. The 2^DIM
+/// children of an internal node are stored contiguously starting at
+/// first_child. Bit i of the child number is set for the children in the
+/// upper half of direction i, so in 2D the order is (bottom left, bottom
+/// right, top left, top right). Leaves have a non-negative leaf id that
+/// indexes the candidate map.
+template <int DIM = 2>
+struct BasicQuadtreeNode
+{
+  AABBox<DIM> bbox;
+  LO first_child;
+  LO leaf_id;
+};
+using QuadtreeNode = BasicQuadtreeNode<2>;
+/// find the leaf that contains the point or the closest leaf if the point is
+/// outside of the tree
+template <int dim>
+[[nodiscard]] KOKKOS_INLINE_FUNCTION LO
+quadtree_leaf(const Kokkos::View<BasicQuadtreeNode<dim>*>& nodes,
+              const Omega_h::Vector<dim>& point)
+{
+  LO node = 0;
+  while (nodes(node).leaf_id < 0) {
+    const auto& center = nodes(node).bbox.center;
+    LO child = 0;
+    for (int i = 0; i < dim; ++i) {
+      child += (point[i] >= center[i]) << i;
+    }
+    node = nodes(node).first_child + child;
+  }
+  return nodes(node).leaf_id;
+}
 }
+
+/// options for the adaptive quadtree (octree in 3D) version of
+/// GridPointSearch
+struct QuadtreeOptions
+{
+  /// leaves are split until they intersect at most this many elements
+  LO max_elements_per_leaf = 8;
+  /// limit on the depth of the tree, since many elements sharing a single
+  /// vertex can never be split below max_elements_per_leaf. At most
+  /// GridPointSearch::max_quadtree_depth
+  LO max_depth = 20;
+};
+/// order in which GridPointSearch processes the query points
+enum class QueryOrder
+{
+  /// the order of the input points. Best when the input is already sorted
+  /// spatially, e.g. the vertices of a mesh
+  Input,
+  /// sort the points along a Morton (Z-order) curve before the search
+  Spatial
+};
 KOKKOS_FUNCTION
 Omega_h::Vector<3> barycentric_from_global(
   const Omega_h::Vector<2>& point, const Omega_h::Matrix<2, 3>& vertex_coords);
+KOKKOS_FUNCTION
+Omega_h::Vector<4> barycentric_from_global(
+  const Omega_h::Vector<3>& point, const Omega_h::Matrix<3, 4>& vertex_coords);
 
 [[nodiscard]] KOKKOS_FUNCTION bool triangle_intersects_bbox(
   const Omega_h::Matrix<2, 3>& coords, const AABBox<2>& bbox);
+[[nodiscard]] KOKKOS_FUNCTION bool tetrahedron_intersects_bbox(
+  const Omega_h::Matrix<3, 4>& coords, const AABBox<3>& bbox);
 
-class GridPointSearch
+/**
+ * Point search over a mesh of simplices (triangles in 2D, tetrahedra in 3D)
+ * accelerated with a uniform grid or an adaptive tree
+ */
+template <int DIM>
+class BasicGridPointSearch
 {
   using CandidateMapT = Kokkos::Crs<LO, Kokkos::DefaultExecutionSpace, void, LO>;
 
 public:
-  static constexpr auto dim = 2;
+  static constexpr auto dim = DIM;
+  /// maximum depth supported by QuadtreeOptions
+  static constexpr LO max_quadtree_depth = 32;
+  /// maximum number of elements visited by the hinted search before falling
+  /// back to the grid
+  static constexpr LO max_walk_steps = 64;
   struct Result {
+    /// tri_id of points for which no element was found, which only happens
+    /// when the mesh has no elements
+    static constexpr LO not_found = std::numeric_limits<LO>::min();
     LO tri_id;
     Omega_h::Vector<dim + 1> parametric_coords;
+    /// true if the point lies inside of the element
+    [[nodiscard]] KOKKOS_INLINE_FUNCTION bool Inside() const noexcept
+    {
+      return tri_id >= 0;
+    }
+    /// true if the point is inside of an element or has a closest element
+    [[nodiscard]] KOKKOS_INLINE_FUNCTION bool Found() const noexcept
+    {
+      return tri_id != not_found;
+    }
+    /// id of the element containing the point, or of the closest element
+    /// if the point is outside of the mesh. -1 if no element was found
+    [[nodiscard]] KOKKOS_INLINE_FUNCTION LO ElementId() const noexcept
+    {
+      if (tri_id == not_found) {
+        return -1;
+      }
+      return (tri_id >= 0) ? tri_id : -tri_id - 1;
+    }
   };
 
-  GridPointSearch(Omega_h::Mesh& mesh, LO Nx, LO Ny);
   /**
-   *  given a point in global coordinates give the id of the triangle that the
+   * @param Nx number of grid cells in the x direction
+   * @param Ny number of grid cells in the y direction
+   * @param Nz number of grid cells in the z direction (3D only)
+   * If any of the used divisions is not positive, the grid is sized
+   * automatically from the number of elements and the aspect ratio of the
+   * mesh bounding box
+   */
+  BasicGridPointSearch(Omega_h::Mesh& mesh, LO Nx = 0, LO Ny = 0, LO Nz = 0);
+  /**
+   * construct the search directly from the element geometry for meshes that
+   * are not stored as an Omega_h mesh
+   * @param coords interleaved vertex coordinates
+   * @param ents2verts 0 based vertex ids of each element (dim+1 per element)
+   */
+  BasicGridPointSearch(Omega_h::Reals coords, Omega_h::LOs ents2verts,
+                       LO Nx = 0, LO Ny = 0, LO Nz = 0);
+  /**
+   * use an adaptive quadtree (octree in 3D) rather than a uniform grid to
+   * find candidate elements. This bounds the number of candidates per leaf
+   * for strongly non-uniform meshes where a uniform grid that is fine enough
+   * for the smallest elements would have too many cells.
+   */
+  BasicGridPointSearch(Omega_h::Mesh& mesh, QuadtreeOptions options);
+  BasicGridPointSearch(Omega_h::Reals coords, Omega_h::LOs ents2verts,
+                       QuadtreeOptions options);
+  /**
+   *  given a point in global coordinates give the id of the element that the
    * point lies within and the parametric coordinate of the point within the
-   * triangle. If the point does not lie within any triangle element. Then the
-   * id will be a negative number and (TODO) will return a negative id of the
-   * closest element
+   * element. If the point does not lie within any element, the id
+   * is -(closest element + 1) and the parametric coordinates are those of the
+   * closest point on the closest element, so that evaluation extrapolates the
+   * boundary value. Use Result::ElementId to get the element in either case.
+   * @param order QueryOrder::Spatial searches the points in Morton order so
+   * that neighboring threads share candidate elements in cache. The results
+   * are always returned in the input order.
    */
-  Kokkos::View<Result*> operator()(Kokkos::View<Real*[dim] > point) const;
+  Kokkos::View<Result*> operator()(Kokkos::View<Real* [dim]> point,
+                                   QueryOrder order = QueryOrder::Input) const;
+  /**
+   * search for points that are expected to lie in or near the elements of a
+   * previous search, e.g. slowly moving particles or points on a deforming
+   * mesh. Starting from the hinted element, the search walks across the face
+   * opposite of the most negative barycentric coordinate until it reaches
+   * the element containing the point. Points for which the walk leaves the
+   * mesh or takes more than max_walk_steps steps use the grid search.
+   * A point on a face shared by several elements may be found in a different
+   * element than the unhinted search returns. The element neighbors needed
+   * for the walk are constructed by the first hinted search.
+   * @param hints results of a previous search of the same points
+   */
+  Kokkos::View<Result*> operator()(Kokkos::View<Real* [dim]> point,
+                                   Kokkos::View<const Result*> hints) const;
 
 private:
-  Omega_h::Mesh mesh_;
-  Kokkos::View<UniformGrid[1]> grid_{"uniform grid"};
+  /// permutation that sorts the points along a Morton curve through the
+  /// bounding box of the search structure
+  Kokkos::View<LO*> SpatialOrder(Kokkos::View<Real* [dim]> points) const;
+  void ConstructUniformGrid(const Omega_h::BBox<dim>& bbox,
+                            std::array<LO, dim> divisions);
+  void ConstructQuadtree(const Omega_h::BBox<dim>& bbox,
+                         const QuadtreeOptions& options);
+  Kokkos::View<BasicUniformGrid<dim>[1]> grid_{"uniform grid"};
+  // empty unless the quadtree is used
+  Kokkos::View<detail::BasicQuadtreeNode<dim>*> quadtree_;
   CandidateMapT candidate_map_;
   Omega_h::LOs tris2verts_;
   Omega_h::Reals coords_;
+  // affine map from global to parametric coordinates of each element
+  detail::InverseBases<dim> inverse_bases_;
+  /// neighbor across each face of each element, constructed on the first
+  /// hinted search
+  const Omega_h::LOs& GetElementNeighbors() const;
+  struct ElementNeighbors
+  {
+    std::once_flag constructed;
+    Omega_h::LOs neighbors;
+  };
+  // shared so that copies of the search construct the neighbors once
+  std::shared_ptr<ElementNeighbors> element_neighbors_{
+    std::make_shared<ElementNeighbors>()};
+  // dual graph of the mesh if it was already available at construction. It
+  // lets the neighbors be matched on the device rather than on the host
+  Omega_h::Graph dual_;
 };
+extern template class BasicGridPointSearch<2>;
+extern template class BasicGridPointSearch<3>;
+using GridPointSearch = BasicGridPointSearch<2>;
+using GridPointSearch3D = BasicGridPointSearch<3>;
 
 } // namespace detail
 #endif // PCMS_COUPLING_POINT_SEARCH_H
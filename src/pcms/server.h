@@ -42,7 +42,7 @@ public:
                           Omega_h::Read<Omega_h::I8> internal_field_mask = {})
     : internal_field_{OmegaHField<typename FieldAdapterT::value_type,
                                   InternalCoordinateElement>(
-        name + ".__internal__", internal_mesh, internal_field_mask, "", 10, 10, field_adapter.GetEntityType())}
+        name + ".__internal__", internal_mesh, internal_field_mask, "", 0, 0, field_adapter.GetEntityType())}
   {
     PCMS_FUNCTION_TIMER;
     coupled_field_ = std::make_unique<CoupledFieldModel<FieldAdapterT, CommT>>(
@@ -58,7 +58,7 @@ public:
                           Omega_h::Read<Omega_h::I8> internal_field_mask)
     : internal_field_{OmegaHField<typename FieldAdapterT::value_type,
                                   InternalCoordinateElement>(
-        name + ".__internal__", internal_mesh, internal_field_mask, "", 10, 10, field_adapter.GetEntityType())}
+        name + ".__internal__", internal_mesh, internal_field_mask, "", 0, 0, field_adapter.GetEntityType())}
   {
     PCMS_FUNCTION_TIMER;
     coupled_field_ =
@@ -444,8 +444,9 @@ public:
     Omega_h::Read<Omega_h::I8> mask = {}, std::string global_id_name = "")
   {
     PCMS_FUNCTION_TIMER;
-    static constexpr int search_nx = 10;
-    static constexpr int search_ny = 10;
+    // size the search grid automatically
+    static constexpr int search_nx = 0;
+    static constexpr int search_ny = 0;
 
     auto& combined = detail::find_or_create_internal_field<CombinedFieldT>(
       internal_field_name, internal_fields_, internal_mesh_, mask,
@@ -480,8 +481,9 @@ public:
     Omega_h::Read<Omega_h::I8> mask = {}, std::string global_id_name = "")
   {
     PCMS_FUNCTION_TIMER;
-    static constexpr int search_nx = 10;
-    static constexpr int search_ny = 10;
+    // size the search grid automatically
+    static constexpr int search_nx = 0;
+    static constexpr int search_ny = 0;
 
     auto& combined = detail::find_or_create_internal_field<CombinedFieldT>(
       internal_field_name, internal_fields_, internal_mesh_, mask,
@@ -0,0 +1,104 @@
+#include "pcms/shared_memory_window.h"
+#include "pcms/assert.h"
+#include <mutex>
+
+namespace pcms
+{
+NodeSharedMemoryWindow::NodeSharedMemoryWindow(MPI_Comm comm,
+                                               std::size_t nbytes)
+  : nbytes_(nbytes)
+{
+  int rank = -1;
+  MPI_Comm_rank(comm, &rank);
+  // using the rank as the key guarantees the lowest rank on each node is the
+  // node leader and that rank 0 of comm is rank 0 of the leader comm
+  MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL,
+                      &node_comm_);
+  MPI_Comm_rank(node_comm_, &node_rank_);
+  MPI_Comm_split(comm, IsNodeLeader() ? 0 : MPI_UNDEFINED, rank,
+                 &leader_comm_);
+  const MPI_Aint local_size =
+    IsNodeLeader() ? static_cast<MPI_Aint>(nbytes_) : 0;
+  void* local_ptr = nullptr;
+  MPI_Win_allocate_shared(local_size, 1, MPI_INFO_NULL, node_comm_,
+                          &local_ptr, &window_);
+  MPI_Aint leader_size = 0;
+  int disp_unit = 0;
+  MPI_Win_shared_query(window_, 0, &leader_size, &disp_unit, &data_);
+  PCMS_ALWAYS_ASSERT(static_cast<std::size_t>(leader_size) == nbytes_);
+  // passive target epoch for the lifetime of the window so that
+  // loads/stores can be ordered with MPI_Win_sync
+  MPI_Win_lock_all(MPI_MODE_NOCHECK, window_);
+}
+
+NodeSharedMemoryWindow::~NodeSharedMemoryWindow()
+{
+  int finalized = 0;
+  MPI_Finalized(&finalized);
+  if (finalized) {
+    return;
+  }
+  Free();
+}
+
+void NodeSharedMemoryWindow::Free()
+{
+  if (window_ != MPI_WIN_NULL) {
+    MPI_Win_unlock_all(window_);
+    MPI_Win_free(&window_);
+  }
+  if (leader_comm_ != MPI_COMM_NULL) {
+    MPI_Comm_free(&leader_comm_);
+  }
+  if (node_comm_ != MPI_COMM_NULL) {
+    MPI_Comm_free(&node_comm_);
+  }
+  data_ = nullptr;
+}
+
+void NodeSharedMemoryWindow::Synchronize() const
+{
+  MPI_Win_sync(window_);
+  MPI_Barrier(node_comm_);
+  MPI_Win_sync(window_);
+}
+
+namespace
+{
+using CachedWindow = std::weak_ptr<NodeSharedMemoryWindow>;
+// the cached window is stored as an attribute of the communicator, so it is
+// dropped when the communicator is freed and a communicator that later gets
+// the same handle does not see it
+int DeleteCachedWindow(MPI_Comm, int, void* attribute, void*)
+{
+  delete static_cast<CachedWindow*>(attribute);
+  return MPI_SUCCESS;
+}
+} // namespace
+
+std::shared_ptr<NodeSharedMemoryWindow> GetNodeSharedMemoryWindow(
+  MPI_Comm comm, std::size_t nbytes)
+{
+  static std::mutex mutex;
+  static int keyval = MPI_KEYVAL_INVALID;
+  std::lock_guard<std::mutex> lock(mutex);
+  if (keyval == MPI_KEYVAL_INVALID) {
+    MPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN, DeleteCachedWindow, &keyval,
+                           nullptr);
+  }
+  void* attribute = nullptr;
+  int found = 0;
+  MPI_Comm_get_attr(comm, keyval, &attribute, &found);
+  auto* cached = static_cast<CachedWindow*>(attribute);
+  if (!found) {
+    cached = new CachedWindow();
+    MPI_Comm_set_attr(comm, keyval, cached);
+  }
+  auto window = cached->lock();
+  if (window == nullptr || window->Size() < nbytes) {
+    window = std::make_shared<NodeSharedMemoryWindow>(comm, nbytes);
+    *cached = window;
+  }
+  return window;
+}
+} // namespace pcms
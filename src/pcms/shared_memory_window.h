@@ -0,0 +1,85 @@
+#ifndef PCMS_COUPLING_SHARED_MEMORY_WINDOW_H
+#define PCMS_COUPLING_SHARED_MEMORY_WINDOW_H
+#include <mpi.h>
+#include <cstddef>
+#include <memory>
+
+namespace pcms
+{
+/**
+ * An MPI-3 shared memory window with a single allocation per node.
+ *
+ * The ranks of the communicator are grouped by node
+ * (MPI_COMM_TYPE_SHARED). The lowest rank on each node (the node leader)
+ * owns the allocation and every rank on the node can directly load and
+ * store into it. The leaders of each node are grouped into a separate
+ * communicator so that data only needs to cross the network once per node.
+ * Rank 0 of the input communicator is always rank 0 of the leader
+ * communicator.
+ *
+ * \Warning construction and Free are collective over the input communicator.
+ * Destroying a window that has not been freed calls Free, so it is also
+ * collective. When copies of a shared_ptr to the window may be destroyed in a
+ * different order on each rank, call Free explicitly instead.
+ */
+class NodeSharedMemoryWindow
+{
+public:
+  NodeSharedMemoryWindow(MPI_Comm comm, std::size_t nbytes);
+  ~NodeSharedMemoryWindow();
+  NodeSharedMemoryWindow(const NodeSharedMemoryWindow&) = delete;
+  NodeSharedMemoryWindow(NodeSharedMemoryWindow&&) = delete;
+  NodeSharedMemoryWindow& operator=(const NodeSharedMemoryWindow&) = delete;
+  NodeSharedMemoryWindow& operator=(NodeSharedMemoryWindow&&) = delete;
+
+  /// pointer to the start of the node shared allocation. This is the same
+  /// memory on every rank of the node
+  [[nodiscard]] void* Data() const noexcept { return data_; }
+  [[nodiscard]] std::size_t Size() const noexcept { return nbytes_; }
+  [[nodiscard]] MPI_Comm GetNodeComm() const noexcept { return node_comm_; }
+  /// communicator of all node leaders. MPI_COMM_NULL on ranks that are not a
+  /// node leader
+  [[nodiscard]] MPI_Comm GetLeaderComm() const noexcept
+  {
+    return leader_comm_;
+  }
+  [[nodiscard]] bool IsNodeLeader() const noexcept { return node_rank_ == 0; }
+  /// make stores from any rank on the node visible to all other ranks on the
+  /// node. Collective over the node communicator.
+  void Synchronize() const;
+  /// release the shared allocation and communicators. Collective over the
+  /// input communicator. Data is null afterwards and destroying the window is
+  /// no longer collective. Calling Free more than once has no effect.
+  void Free();
+  [[nodiscard]] bool IsFreed() const noexcept
+  {
+    return window_ == MPI_WIN_NULL;
+  }
+
+private:
+  MPI_Comm node_comm_{MPI_COMM_NULL};
+  MPI_Comm leader_comm_{MPI_COMM_NULL};
+  MPI_Win window_{MPI_WIN_NULL};
+  int node_rank_{-1};
+  void* data_{nullptr};
+  std::size_t nbytes_{0};
+};
+
+/**
+ * Get a node shared memory window over comm that holds at least nbytes.
+ *
+ * Windows are cached per communicator, so every user of the same communicator
+ * shares a single allocation and a single set of node/leader communicators
+ * while any of them holds the returned pointer. A new window is created if the
+ * cached window has been released or is smaller than nbytes. The cache is an
+ * attribute of comm, so freeing comm drops it.
+ *
+ * \Warning collective over comm. Every rank must request the same sizes in
+ * the same order and release the windows in the same order. Users of the
+ * shared window must synchronize the node before the data is overwritten.
+ */
+[[nodiscard]] std::shared_ptr<NodeSharedMemoryWindow> GetNodeSharedMemoryWindow(
+  MPI_Comm comm, std::size_t nbytes);
+} // namespace pcms
+
+#endif // PCMS_COUPLING_SHARED_MEMORY_WINDOW_H
@@ -1,10 +1,13 @@
 #ifndef PCMS_COUPLING_TRANSFER_FIELD_H
 #define PCMS_COUPLING_TRANSFER_FIELD_H
+#include <functional>
 #include <utility>
 #include "pcms/arrays.h"
 #include "pcms/field_evaluation_methods.h"
 #include "pcms/field.h"
 #include "pcms/profile.h"
+#include "pcms/assert.h"
+#include "pcms/external/span.h"
 
 namespace pcms
 {
@@ -76,6 +79,32 @@ void interpolate_field(const SourceField& source_field,
     set_nodal_data(target_field, make_array_view(data));
   }
 }
+/**
+ * Interpolate several source fields that are defined on the same mesh onto
+ * target fields that share the same coordinates, e.g. fields on the same
+ * mesh and entity type. The coordinates of the first target field are
+ * searched once and all of the fields are evaluated together with
+ * evaluate_many.
+ */
+template <typename SourceField, typename TargetField,
+          typename EvaluationMethod = Lagrange<1>>
+void interpolate_fields(
+  nonstd::span<const std::reference_wrapper<const SourceField>> source_fields,
+  nonstd::span<const std::reference_wrapper<TargetField>> target_fields,
+  EvaluationMethod method = {})
+{
+  PCMS_FUNCTION_TIMER;
+  PCMS_ALWAYS_ASSERT(source_fields.size() == target_fields.size());
+  if (target_fields.empty()) {
+    return;
+  }
+  auto coordinates = get_nodal_coordinates(target_fields[0].get());
+  auto coordinates_view = make_const_array_view(coordinates);
+  const auto data = evaluate_many(source_fields, method, coordinates_view);
+  for (std::size_t i = 0; i < target_fields.size(); ++i) {
+    set_nodal_data(target_fields[i].get(), make_array_view(data[i]));
+  }
+}
 template <typename SourceField, typename TargetField>
 void transfer_field(const SourceField& source, TargetField& target,
                     FieldTransferMethod transfer_method,
@@ -6,10 +6,17 @@
 #include <numeric>
 namespace pcms
 {
-struct UniformGrid
+/**
+ * Uniform grid of axis aligned cells in DIM dimensions. Cells are numbered
+ * with the first coordinate direction (x) varying fastest. Dimensioned cell
+ * indexes are stored in the opposite order of the coordinates, i.e. in 2D
+ * the index is (row, column) = (y, x) and in 3D it is (z, y, x).
+ */
+template <int DIM = 2>
+struct BasicUniformGrid
 {
   // Make private?
-  static constexpr int dim = 2;
+  static constexpr int dim = DIM;
   std::array<Real, dim> edge_length;
   std::array<Real, dim> bot_left;
   std::array<LO, dim> divisions;
@@ -23,45 +30,69 @@ public:
   // take the view as a template because it might be a subview type
   //template <typename T>
   //[[nodiscard]] KOKKOS_INLINE_FUNCTION LO ClosestCellID(const T& point) const
-  [[nodiscard]] KOKKOS_INLINE_FUNCTION LO ClosestCellID(const Omega_h::Vector<2>& point) const
+  [[nodiscard]] KOKKOS_INLINE_FUNCTION LO ClosestCellID(const Omega_h::Vector<dim>& point) const
   {
-    std::array<Real, dim> distance_within_grid{point[0] - bot_left[0],
-                                               point[1] - bot_left[1]};
-    std::array<LO, dim> indexes{-1, -1};
+    std::array<LO, dim> indexes;
     // note that the indexes refer to row/columns which have the opposite order
     // of the coordinates i.e. x,y
     for (int i = 0; i < dim; ++i) {
-      if (distance_within_grid[i] <= 0) {
+      const Real distance_within_grid = point[i] - bot_left[i];
+      if (distance_within_grid <= 0) {
         indexes[dim - (i + 1)] = 0;
-      } else if (distance_within_grid[i] >= edge_length[i]) {
+      } else if (distance_within_grid >= edge_length[i]) {
         indexes[dim - (i + 1)] = divisions[i] - 1;
       } else {
-        indexes[dim - (i + 1)] = 
-          static_cast<LO>(std::floor(distance_within_grid[i] * divisions[i]/edge_length[i]));
+        indexes[dim - (i + 1)] =
+          static_cast<LO>(std::floor(distance_within_grid * divisions[i]/edge_length[i]));
       }
     }
-    return GetCellIndex(indexes[0], indexes[1]);
+    return GetCellIndex(indexes);
   }
   [[nodiscard]] KOKKOS_INLINE_FUNCTION AABBox<dim> GetCellBBOX(LO idx) const
   {
-    auto [i, j] = GetTwoDCellIndex(idx);
-    std::array<Real, dim> half_width = {edge_length[0] / (2.0 * divisions[0]),
-                                        edge_length[1] / (2.0 * divisions[1])};
-    AABBox<dim> bbox{.center = {(2.0 * j + 1.0) * half_width[0]+bot_left[0],
-                                (2.0 * i + 1.0) * half_width[1]+bot_left[1]},
-                     .half_width = half_width};
+    const auto indexes = GetDimensionedIndex(idx);
+    AABBox<dim> bbox;
+    for (int i = 0; i < dim; ++i) {
+      bbox.half_width[i] = edge_length[i] / (2.0 * divisions[i]);
+      bbox.center[i] =
+        (2.0 * indexes[dim - (i + 1)] + 1.0) * bbox.half_width[i] + bot_left[i];
+    }
     return bbox;
   }
+  [[nodiscard]] KOKKOS_INLINE_FUNCTION std::array<LO, dim> GetDimensionedIndex(
+    LO idx) const
+  {
+    std::array<LO, dim> indexes;
+    for (int i = 0; i < dim; ++i) {
+      indexes[dim - (i + 1)] = idx % divisions[i];
+      idx /= divisions[i];
+    }
+    return indexes;
+  }
+  [[nodiscard]] KOKKOS_INLINE_FUNCTION LO
+  GetCellIndex(const std::array<LO, dim>& indexes) const
+  {
+    LO idx = 0;
+    for (int i = dim - 1; i >= 0; --i) {
+      OMEGA_H_CHECK(indexes[dim - (i + 1)] >= 0 &&
+                    indexes[dim - (i + 1)] < divisions[i]);
+      idx = idx * divisions[i] + indexes[dim - (i + 1)];
+    }
+    return idx;
+  }
   [[nodiscard]] KOKKOS_INLINE_FUNCTION std::array<LO, 2> GetTwoDCellIndex(LO idx) const
   {
-    return {idx / divisions[0], idx % divisions[0]};
+    static_assert(dim == 2, "GetTwoDCellIndex requires a 2D grid");
+    return GetDimensionedIndex(idx);
   }
   [[nodiscard]] KOKKOS_INLINE_FUNCTION LO GetCellIndex(LO i, LO j) const
   {
-    OMEGA_H_CHECK(i >= 0 && j >= 0 && i < divisions[1] && j < divisions[0]);
-    return i * divisions[0] + j;
+    static_assert(dim == 2, "GetCellIndex(i,j) requires a 2D grid");
+    return GetCellIndex(std::array<LO, 2>{i, j});
   }
 };
+using UniformGrid = BasicUniformGrid<2>;
+using UniformGrid3D = BasicUniformGrid<3>;
 } // namespace pcms
 
 #endif // PCMS_COUPLING_UNIFORM_GRID_H
@@ -10,6 +10,8 @@
 #include "pcms/assert.h"
 #include "pcms/array_mask.h"
 #include "pcms/profile.h"
+#include "pcms/shared_memory_window.h"
+#include <memory>
 
 namespace pcms
 {
@@ -37,6 +39,83 @@ struct GetRank
 };
 } // namespace detail
 
+/**
+ * Method used to couple the field data that is replicated on every rank of
+ * an XGC plane
+ */
+enum class XGCPlaneCommunication
+{
+  /// plane root sends/receives the full plane and MPI_Bcast duplicates
+  /// received data to every rank of the plane
+  Broadcast,
+  /// plane root sends/receives the full plane. Received data is broadcast
+  /// once per node into an MPI-3 shared memory window, and each rank on the
+  /// node copies the field out of the window
+  SharedMemory,
+  /// the plane vertices are split into contiguous blocks over the ranks of the
+  /// plane and every rank sends/receives its own block. Received blocks are
+  /// assembled on every rank with MPI_Allgatherv. All ranks of the plane must
+  /// participate in the coupling communication.
+  Distributed
+};
+
+/**
+ * Triangle geometry of an XGC plane used to evaluate XGC fields at arbitrary
+ * points. The geometry is the same for every field on the plane, so a single
+ * instance should be shared by all of the field adapters.
+ */
+class XGCMeshGeometry
+{
+public:
+  /**
+   * @param coordinates interleaved (r,z) coordinates of each vertex in XGC
+   * iteration order
+   * @param triangles vertex ids of each triangle (3 per triangle)
+   * @param index_base index base of the vertex ids. XGC uses 1 based indexing
+   * @param search_nx number of grid cells in r used for the point search
+   * @param search_ny number of grid cells in z used for the point search. The
+   * grid is sized automatically if either is not positive
+   */
+  XGCMeshGeometry(ScalarArrayView<const Real, HostMemorySpace> coordinates,
+                  ScalarArrayView<const LO, HostMemorySpace> triangles,
+                  IndexBase index_base = IndexBase::One, LO search_nx = 0,
+                  LO search_ny = 0)
+    : coords_(CopyToOmegaH(coordinates)),
+      tris2verts_(CopyToOmegaH(triangles, static_cast<LO>(index_base))),
+      search_(coords_, tris2verts_, search_nx, search_ny)
+  {
+    PCMS_FUNCTION_TIMER;
+  }
+  [[nodiscard]] const Omega_h::Reals& GetCoordinates() const noexcept
+  {
+    return coords_;
+  }
+  [[nodiscard]] const Omega_h::LOs& GetTriangles() const noexcept
+  {
+    return tris2verts_;
+  }
+  [[nodiscard]] LO GetNumVerts() const noexcept { return coords_.size() / 2; }
+  [[nodiscard]] const GridPointSearch& GetSearch() const noexcept
+  {
+    return search_;
+  }
+
+private:
+  template <typename T>
+  static Omega_h::Read<T> CopyToOmegaH(
+    ScalarArrayView<const T, HostMemorySpace> array, T shift = 0)
+  {
+    Omega_h::HostWrite<T> array_h(array.size());
+    for (size_t i = 0; i < array.size(); ++i) {
+      array_h[i] = array[i] - shift;
+    }
+    return Omega_h::Read<T>(array_h.write());
+  }
+  Omega_h::Reals coords_;
+  Omega_h::LOs tris2verts_;
+  GridPointSearch search_;
+};
+
 template <typename T, typename CoordinateElementType = Real>
 class XGCFieldAdapter
 {
@@ -51,42 +130,87 @@ public:
    * given XGC plane. This corresponds to sml_plane_comm
    * @param data a view of the data to be used as the field definition
    * @param reverse_classification the reverse classification data for the XGC
-   * field
+   * field. The views are shallow copied, so a reverse classification that is
+   * converted to the CSR form once can be shared between many fields without
+   * duplicating the storage
    * @param in_overlap a function describing if an entity defined by the
    * geometric dimension and ID
+   * @param plane_communication which ranks of the plane communicate and how
+   * received data is duplicated across the plane communicator. SharedMemory
+   * requires the constructor to be called collectively on plane_communicator
    */
-  XGCFieldAdapter(std::string name, MPI_Comm plane_communicator,
-                  ScalarArrayView<T, memory_space> data,
-                  const ReverseClassificationVertex& reverse_classification,
-                  std::function<int8_t(int, int)> in_overlap)
+  XGCFieldAdapter(
+    std::string name, MPI_Comm plane_communicator,
+    ScalarArrayView<T, memory_space> data,
+    ReverseClassificationVertexCSR<memory_space> reverse_classification,
+    std::function<int8_t(int, int)> in_overlap,
+    XGCPlaneCommunication plane_communication =
+      XGCPlaneCommunication::Broadcast)
     : name_(std::move(name)),
       plane_comm_(plane_communicator),
       data_(data),
       gids_(data.size()),
-      reverse_classification_(reverse_classification),
-      in_overlap_(in_overlap)
+      reverse_classification_(std::move(reverse_classification)),
+      in_overlap_(in_overlap),
+      plane_communication_(plane_communication)
   {
     PCMS_FUNCTION_TIMER;
     // PCMS_ALWAYS_ASSERT(reverse_classification.nverts() == data.size());
     MPI_Comm_rank(plane_comm_, &plane_rank_);
+    if (plane_communication_ == XGCPlaneCommunication::SharedMemory) {
+      // a single window is shared by all adapters on the plane communicator
+      shared_data_ =
+        GetNodeSharedMemoryWindow(plane_comm_, data.size() * sizeof(T));
+    }
+    if (plane_communication_ == XGCPlaneCommunication::Distributed) {
+      ConstructPlaneBlocks();
+    } else {
+      owned_begin_ = 0;
+      owned_end_ = data.size();
+    }
     if (RankParticipatesCouplingCommunication()) {
       Kokkos::View<int8_t*, HostMemorySpace> mask("mask", data.size());
       PCMS_ALWAYS_ASSERT((bool)in_overlap);
-      for (auto& geom : reverse_classification_) {
-        if (in_overlap(geom.first.dim, geom.first.id)) {
-          for (auto vert : geom.second) {
+      const auto& geometry = reverse_classification_.GetGeometry();
+      for (LO i = 0; i < reverse_classification_.GetNumGeometricEntities();
+           ++i) {
+        if (in_overlap(geometry(i).dim, geometry(i).id)) {
+          auto verts = reverse_classification_.GetEntityVerts(i);
+          for (size_t j = 0; j < verts.size(); ++j) {
+            const auto vert = verts[j];
             PCMS_ALWAYS_ASSERT(vert < data.size());
-            mask(vert) = 1;
+            mask(vert) = IsOwned(vert);
           }
         }
       }
       mask_ = ArrayMask<memory_space>{make_const_array_view(mask)};
-      PCMS_ALWAYS_ASSERT(!mask_.empty());
+      // with a distributed plane a block may not contain any overlap vertices
+      PCMS_ALWAYS_ASSERT(!mask_.empty() ||
+                         plane_communication_ ==
+                           XGCPlaneCommunication::Distributed);
       //// XGC meshes are naively ordered in iteration order (full mesh on every
       //// cpu) First ID in XGC is 1!
       std::iota(gids_.begin(), gids_.end(), static_cast<GO>(1));
     }
   }
+  /**
+   * @param reverse_classification the reverse classification data for the XGC
+   * field. It is converted to a new CSR for every adapter, so fields that share
+   * a reverse classification should convert it once and use the constructor
+   * above
+   */
+  XGCFieldAdapter(std::string name, MPI_Comm plane_communicator,
+                  ScalarArrayView<T, memory_space> data,
+                  const ReverseClassificationVertex& reverse_classification,
+                  std::function<int8_t(int, int)> in_overlap,
+                  XGCPlaneCommunication plane_communication =
+                    XGCPlaneCommunication::Broadcast)
+    : XGCFieldAdapter(
+        std::move(name), plane_communicator, data,
+        ReverseClassificationVertexCSR<memory_space>{reverse_classification},
+        std::move(in_overlap), plane_communication)
+  {
+  }
 
   int Serialize(
     ScalarArrayView<T, memory_space> buffer,
@@ -98,7 +222,7 @@ public:
     if (RankParticipatesCouplingCommunication()) {
       auto const_data = ScalarArrayView<const T, memory_space>{
         data_.data_handle(), data_.size()};
-      if (buffer.size() > 0) {
+      if (buffer.size() > 0 && !mask_.empty()) {
         mask_.Apply(const_data, buffer, permutation);
       }
       return mask_.Size();
@@ -112,9 +236,20 @@ public:
     PCMS_FUNCTION_TIMER;
     static_assert(std::is_same_v<memory_space, pcms::HostMemorySpace>,
                   "gpu space unhandled\n");
-    if (RankParticipatesCouplingCommunication()) {
+    if (RankParticipatesCouplingCommunication() && !mask_.empty()) {
       mask_.ToFullArray(buffer, data_, permutation);
     }
+    if (plane_communication_ == XGCPlaneCommunication::Distributed) {
+      // assemble the blocks owned by each rank into the full plane
+      MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, data_.data_handle(),
+                     block_counts_.data(), block_offsets_.data(),
+                     redev::getMpiType(value_type{}), plane_comm_);
+      return;
+    }
+    if (shared_data_) {
+      BroadcastSharedMemory();
+      return;
+    }
     // duplicate the data on the root rank of the plane to all other ranks
     MPI_Bcast(data_.data_handle(), data_.size(),
               redev::getMpiType(value_type{}), plane_root_, plane_comm_);
@@ -124,7 +259,7 @@ public:
   [[nodiscard]] std::vector<GO> GetGids() const
   {
     PCMS_FUNCTION_TIMER;
-    if (RankParticipatesCouplingCommunication()) {
+    if (RankParticipatesCouplingCommunication() && !mask_.empty()) {
       std::vector<GO> gids(mask_.Size());
       auto v1 = make_array_view(gids_);
       auto v2 = make_array_view(gids);
@@ -144,23 +279,34 @@ public:
       pcms::ReversePartitionMap reverse_partition;
       // in_overlap_ must contain a function!
       PCMS_ALWAYS_ASSERT(static_cast<bool>(in_overlap_));
-      for (const auto& geom : reverse_classification_) {
+      const auto& geometry = reverse_classification_.GetGeometry();
+      // the map gives the local iteration order of the global ids
+      auto map = mask_.GetMap();
+      for (LO i = 0; i < reverse_classification_.GetNumGeometricEntities();
+           ++i) {
         // if the geometry is in specified overlap region
-        if (in_overlap_(geom.first.dim, geom.first.id)) {
+        if (in_overlap_(geometry(i).dim, geometry(i).id)) {
 
-          auto dr = std::visit(detail::GetRank{geom.first}, partition);
+          auto dr = std::visit(detail::GetRank{geometry(i)}, partition);
           auto [it, inserted] = reverse_partition.try_emplace(dr);
-          // the map gives the local iteration order of the global ids
-          auto map = mask_.GetMap();
-          std::transform(geom.second.begin(), geom.second.end(),
-                         std::back_inserter(it->second), [&map](auto v) {
-                           auto idx = map[v];
-                           PCMS_ALWAYS_ASSERT(idx > 0);
-                           return idx - 1;
-                         });
+          auto verts = reverse_classification_.GetEntityVerts(i);
+          for (size_t j = 0; j < verts.size(); ++j) {
+            const auto v = verts[j];
+            if (IsOwned(v)) {
+              auto idx = map[v];
+              PCMS_ALWAYS_ASSERT(idx > 0);
+              it->second.push_back(idx - 1);
+            }
+          }
         }
       }
 
+      // with a distributed plane, geometric entities may have no vertices in
+      // the block owned by this rank
+      for (auto it = reverse_partition.begin();
+           it != reverse_partition.end();) {
+        it = it->second.empty() ? reverse_partition.erase(it) : std::next(it);
+      }
       // Rather than convert an explicit forward classification,
       // we can construct the reverse partitionbased on the geometry
       // and sort the node ids after to get the iteration order correct
@@ -175,24 +321,100 @@ public:
   [[nodiscard]] bool RankParticipatesCouplingCommunication() const noexcept
   {
     PCMS_FUNCTION_TIMER;
-    // only do adios communications on 0 rank of the XGC fields
-    return (plane_rank_ == plane_root_);
+    // only do adios communications on 0 rank of the XGC fields unless the
+    // plane is distributed
+    return (plane_communication_ == XGCPlaneCommunication::Distributed) ||
+           (plane_rank_ == plane_root_);
   }
 
   [[nodiscard]] pcms::mesh_entity_type GetEntityType() const noexcept
   {
     return pcms::mesh_entity_type::VERTEX;
   }
+  /// set the plane geometry that is needed to evaluate the field at
+  /// arbitrary points
+  void SetGeometry(std::shared_ptr<const XGCMeshGeometry> geometry)
+  {
+    PCMS_ALWAYS_ASSERT(geometry != nullptr);
+    PCMS_ALWAYS_ASSERT(geometry->GetNumVerts() ==
+                       static_cast<LO>(data_.size()));
+    geometry_ = std::move(geometry);
+  }
+  [[nodiscard]] const XGCMeshGeometry* GetGeometry() const noexcept
+  {
+    return geometry_.get();
+  }
+  [[nodiscard]] ScalarArrayView<T, memory_space> GetData() const noexcept
+  {
+    return data_;
+  }
 
 private:
+  // split the plane vertices into contiguous blocks with one block per rank
+  void ConstructPlaneBlocks()
+  {
+    PCMS_FUNCTION_TIMER;
+    int plane_size = -1;
+    MPI_Comm_size(plane_comm_, &plane_size);
+    const LO nverts = data_.size();
+    block_counts_.resize(plane_size);
+    block_offsets_.resize(plane_size);
+    for (int i = 0; i < plane_size; ++i) {
+      block_offsets_[i] =
+        static_cast<LO>((static_cast<GO>(nverts) * i) / plane_size);
+    }
+    for (int i = 0; i < plane_size; ++i) {
+      const auto next = (i + 1 < plane_size) ? block_offsets_[i + 1] : nverts;
+      block_counts_[i] = next - block_offsets_[i];
+    }
+    owned_begin_ = block_offsets_[plane_rank_];
+    owned_end_ = owned_begin_ + block_counts_[plane_rank_];
+  }
+  [[nodiscard]] bool IsOwned(LO vert) const noexcept
+  {
+    return vert >= owned_begin_ && vert < owned_end_;
+  }
+  // duplicate the data on the root rank of the plane to all other ranks with
+  // a single copy of the data per node
+  void BroadcastSharedMemory() const
+  {
+    PCMS_FUNCTION_TIMER;
+    auto* shared = reinterpret_cast<T*>(shared_data_->Data());
+    const auto n = data_.size();
+    if (shared_data_->IsNodeLeader()) {
+      if (RankParticipatesCouplingCommunication()) {
+        std::copy_n(data_.data_handle(), n, shared);
+      }
+      // plane root is always rank 0 of the leader communicator
+      MPI_Bcast(shared, n, redev::getMpiType(value_type{}), 0,
+                shared_data_->GetLeaderComm());
+    }
+    shared_data_->Synchronize();
+    if (!RankParticipatesCouplingCommunication()) {
+      std::copy_n(shared, n, data_.data_handle());
+    }
+    // the window cannot be written by the next receive until all ranks on the
+    // node have finished reading
+    shared_data_->Synchronize();
+  }
+
   std::string name_;
   MPI_Comm plane_comm_;
   int plane_rank_;
   ScalarArrayView<T, memory_space> data_;
   std::vector<GO> gids_;
-  const ReverseClassificationVertex& reverse_classification_;
+  ReverseClassificationVertexCSR<memory_space> reverse_classification_;
   std::function<int8_t(int, int)> in_overlap_;
   ArrayMask<memory_space> mask_;
+  XGCPlaneCommunication plane_communication_;
+  std::shared_ptr<NodeSharedMemoryWindow> shared_data_;
+  // range of vertex indices this rank sends/receives
+  LO owned_begin_;
+  LO owned_end_;
+  // block decomposition of the plane used with distributed communication
+  std::vector<int> block_counts_;
+  std::vector<int> block_offsets_;
+  std::shared_ptr<const XGCMeshGeometry> geometry_;
   static constexpr int plane_root_{0};
 };
 
@@ -219,11 +441,114 @@ auto get_nodal_coordinates(
   const XGCFieldAdapter<T, CoordinateElementType>& field)
 {
   PCMS_FUNCTION_TIMER;
-  Kokkos::View<CoordinateElementType*,
-               typename XGCFieldAdapter<T, CoordinateElementType>::memory_space>
-    coordinates;
+  using memory_space =
+    typename XGCFieldAdapter<T, CoordinateElementType>::memory_space;
+  const auto* geometry = field.GetGeometry();
+  if (geometry == nullptr) {
+    return Kokkos::View<CoordinateElementType*, memory_space>{};
+  }
+  const auto& coords = geometry->GetCoordinates();
+  Kokkos::View<CoordinateElementType*, memory_space> coordinates(
+    "coordinates", coords.size());
+  Kokkos::deep_copy(coordinates, Kokkos::View<const Real*>(coords.data(),
+                                                           coords.size()));
   return coordinates;
 }
+
+namespace detail
+{
+// locate each point in the XGC plane and evaluate the field using the
+// element and barycentric coordinates of the point
+template <typename T, typename CoordinateElementType, typename MemorySpace,
+          typename ElementEvaluation>
+auto evaluate_xgc(
+  const XGCFieldAdapter<T, CoordinateElementType>& field,
+  ScalarArrayView<const CoordinateElementType, MemorySpace> coordinates,
+  ElementEvaluation element_evaluation) -> Kokkos::View<T*, MemorySpace>
+{
+  PCMS_FUNCTION_TIMER;
+  const auto* geometry = field.GetGeometry();
+  if (geometry == nullptr) {
+    std::cerr << "Evaluation of XGC Field requires the plane geometry. Call "
+                 "SetGeometry on the field adapter.\n";
+    std::abort();
+  }
+  const LO npts = coordinates.size() / 2;
+  // point search and field data live in the default execution space
+  auto coordinates_d = Kokkos::create_mirror_view_and_copy(
+    DefaultExecutionSpace::memory_space{},
+    Kokkos::View<const CoordinateElementType*, MemorySpace>(
+      coordinates.data_handle(), coordinates.size()));
+  Kokkos::View<Real* [2]> points("points", npts);
+  Kokkos::parallel_for(
+    npts, KOKKOS_LAMBDA(LO i) {
+      points(i, 0) = coordinates_d(2 * i);
+      points(i, 1) = coordinates_d(2 * i + 1);
+    });
+  auto results = geometry->GetSearch()(points);
+  const auto data = field.GetData();
+  auto field_values = Kokkos::create_mirror_view_and_copy(
+    DefaultExecutionSpace::memory_space{},
+    Kokkos::View<const T*, HostMemorySpace>(data.data_handle(), data.size()));
+  auto tris2verts = geometry->GetTriangles();
+  Kokkos::View<T*> values("data", npts);
+  Kokkos::parallel_for(
+    npts, KOKKOS_LAMBDA(LO i) {
+      // meshes without elements have no closest element
+      if (!results(i).Found()) {
+        values(i) = 0;
+        return;
+      }
+      // points outside of the mesh use the closest point on the closest
+      // element
+      const auto elem_idx = results(i).ElementId();
+      const auto coord = results(i).parametric_coords;
+      const auto elem_tri2verts =
+        Omega_h::gather_verts<3>(tris2verts, elem_idx);
+      values(i) = element_evaluation(field_values, elem_tri2verts, coord);
+    });
+  return Kokkos::create_mirror_view_and_copy(MemorySpace{}, values);
+}
+template <typename T>
+struct XGCLagrangeEvaluation
+{
+  template <typename FieldValues>
+  KOKKOS_INLINE_FUNCTION T operator()(const FieldValues& field_values,
+                                      const Omega_h::Few<LO, 3>& verts,
+                                      const Omega_h::Vector<3>& coord) const
+  {
+    Real val = 0;
+    for (int j = 0; j < 3; ++j) {
+      val += field_values(verts[j]) * coord[j];
+    }
+    if constexpr (std::is_integral_v<T>) {
+      val = std::round(val);
+    }
+    return static_cast<T>(val);
+  }
+};
+template <typename T>
+struct XGCNearestNeighborEvaluation
+{
+  template <typename FieldValues>
+  KOKKOS_INLINE_FUNCTION T operator()(const FieldValues& field_values,
+                                      const Omega_h::Few<LO, 3>& verts,
+                                      const Omega_h::Vector<3>& coord) const
+  {
+    // value is closest to point has the largest coordinate
+    int vert = 0;
+    auto max_val = coord[0];
+    for (int j = 1; j <= 2; ++j) {
+      if (coord[j] > max_val) {
+        max_val = coord[j];
+        vert = j;
+      }
+    }
+    return field_values(verts[vert]);
+  }
+};
+} // namespace detail
+
 template <typename T, typename CoordinateElementType, typename MemorySpace>
 auto evaluate(
   const XGCFieldAdapter<T, CoordinateElementType>& field,
@@ -232,10 +557,8 @@ auto evaluate(
   -> Kokkos::View<T*, MemorySpace>
 {
   PCMS_FUNCTION_TIMER;
-  Kokkos::View<T*, MemorySpace> values("data", coordinates.size() / 2);
-  std::cerr << "Evaluation of XGC Field not implemented yet!\n";
-  std::abort();
-  return values;
+  return detail::evaluate_xgc(field, coordinates,
+                              detail::XGCLagrangeEvaluation<T>{});
 }
 template <typename T, typename CoordinateElementType, typename MemorySpace>
 auto evaluate(
@@ -245,10 +568,8 @@ auto evaluate(
   -> Kokkos::View<T*, MemorySpace>
 {
   PCMS_FUNCTION_TIMER;
-  Kokkos::View<T*, MemorySpace> values("data", coordinates.size() / 2);
-  std::cerr << "Evaluation of XGC Field not implemented yet!\n";
-  std::abort();
-  return values;
+  return detail::evaluate_xgc(field, coordinates,
+                              detail::XGCNearestNeighborEvaluation<T>{});
 }
 
 template <typename T, typename CoordinateElementType, typename U>
@@ -259,6 +580,13 @@ auto set_nodal_data(
     data) -> void
 {
   PCMS_FUNCTION_TIMER;
+  static_assert(std::is_convertible_v<U, T>,
+                "must be able to convert nodal data into the field types data");
+  auto field_data = field.GetData();
+  PCMS_ALWAYS_ASSERT(data.size() == field_data.size());
+  for (size_t i = 0; i < data.size(); ++i) {
+    field_data[i] = static_cast<T>(data[i]);
+  }
 }
 
 } // namespace pcms
@@ -3,8 +3,63 @@
 #include <fstream>
 #include "pcms/assert.h"
 #include <string>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <memory>
+#include "pcms/shared_memory_window.h"
 namespace pcms
 {
+namespace
+{
+// deleter of the window that backs a broadcast reverse classification. Since
+// the storage of the CSR is type erased, the deleter is used to identify the
+// window and get mutable access to it when it is freed
+struct ReverseClassificationWindowDeleter
+{
+  NodeSharedMemoryWindow* window;
+  void operator()(NodeSharedMemoryWindow* w) const { delete w; }
+};
+// broadcast an arbitrary number of bytes. The data is split into chunks whose
+// counts fit in an int and a few chunks are kept in flight so that the
+// broadcast of one chunk overlaps the next.
+void BroadcastBytes(void* data, size_t nbytes, int root, MPI_Comm comm)
+{
+  PCMS_FUNCTION_TIMER;
+  constexpr size_t chunk_size = size_t{1} << 26;
+  constexpr size_t max_in_flight = 4;
+  std::array<MPI_Request, max_in_flight> requests;
+  requests.fill(MPI_REQUEST_NULL);
+  auto* bytes = static_cast<char*>(data);
+  size_t chunk = 0;
+  for (size_t offset = 0; offset < nbytes; offset += chunk_size, ++chunk) {
+    auto& request = requests[chunk % max_in_flight];
+    MPI_Wait(&request, MPI_STATUS_IGNORE);
+    const auto count = static_cast<int>(std::min(chunk_size, nbytes - offset));
+    MPI_Ibcast(bytes + offset, count, MPI_BYTE, root, comm, &request);
+  }
+  MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+}
+
+constexpr char rc_binary_magic[8] = {'P', 'C', 'M', 'S', 'R', 'C', 'V', '\0'};
+constexpr uint32_t rc_binary_version = 1;
+struct ReverseClassificationBinaryHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t lo_size;
+  uint64_t num_geometry;
+  uint64_t num_verts;
+};
+static_assert(sizeof(ReverseClassificationBinaryHeader) == 32,
+              "header layout is part of the file format");
+static_assert(sizeof(DimID) == 2 * sizeof(LO),
+              "geometry is stored as (dim, id) pairs");
+} // namespace
 
 std::vector<LO> ReverseClassificationVertex::Serialize() const
 {
@@ -73,19 +128,16 @@ ReverseClassificationVertex ReadReverseClassificationVertex(std::istream& instr,
   if (rank == root) {
     auto rc = ReadReverseClassificationVertex(instr);
     auto serialized_rc = rc.Serialize();
-    static_assert(std::is_same_v<LO, int32_t>,
-                  "mpi type hardcoded, must update");
-    size_t sz = serialized_rc.size();
-    MPI_Bcast(&sz, 1, MPI_INT64_T, root, comm);
-    MPI_Bcast(serialized_rc.data(), serialized_rc.size(), MPI_INT32_T, root,
-              comm);
+    uint64_t sz = serialized_rc.size();
+    MPI_Bcast(&sz, 1, MPI_UINT64_T, root, comm);
+    BroadcastBytes(serialized_rc.data(), sz * sizeof(LO), root, comm);
     return rc;
   } else {
-    size_t sz = 0;
-    MPI_Bcast(&sz, 1, MPI_INT64_T, root, comm);
+    uint64_t sz = 0;
+    MPI_Bcast(&sz, 1, MPI_UINT64_T, root, comm);
     std::vector<LO> serialized_rc(sz);
     PCMS_ALWAYS_ASSERT(serialized_rc.size() == sz);
-    MPI_Bcast(serialized_rc.data(), sz, MPI_INT32_T, root, comm);
+    BroadcastBytes(serialized_rc.data(), sz * sizeof(LO), root, comm);
     pcms::ScalarArrayView<pcms::LO, pcms::HostMemorySpace> av{
       serialized_rc.data(), serialized_rc.size()};
     ReverseClassificationVertex rc;
@@ -157,4 +209,172 @@ std::ostream& operator<<(std::ostream& os, const ReverseClassificationVertex& v)
   return os;
 }
 
+void WriteReverseClassificationVertexBinary(
+  const ReverseClassificationVertexCSR<HostMemorySpace>& rc,
+  const std::string& filename)
+{
+  PCMS_FUNCTION_TIMER;
+  ReverseClassificationBinaryHeader header{};
+  std::memcpy(header.magic, rc_binary_magic, sizeof(header.magic));
+  header.version = rc_binary_version;
+  header.lo_size = sizeof(LO);
+  header.num_geometry = rc.GetNumGeometricEntities();
+  header.num_verts = rc.GetTotalVerts();
+  std::ofstream outfile(filename, std::ios::binary);
+  if (!outfile.is_open()) {
+    std::cerr << "Cannot open reverse classification file " << filename
+              << "\n";
+  }
+  PCMS_ALWAYS_ASSERT(outfile.is_open());
+  outfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  outfile.write(reinterpret_cast<const char*>(rc.GetGeometry().data()),
+                header.num_geometry * sizeof(DimID));
+  outfile.write(reinterpret_cast<const char*>(rc.GetOffsets().data()),
+                (header.num_geometry + 1) * sizeof(LO));
+  outfile.write(reinterpret_cast<const char*>(rc.GetVerts().data()),
+                header.num_verts * sizeof(LO));
+  PCMS_ALWAYS_ASSERT(outfile.good());
+}
+
+ReverseClassificationVertexCSR<HostMemorySpace>
+MapReverseClassificationVertexBinary(const std::string& filename)
+{
+  PCMS_FUNCTION_TIMER;
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Cannot open reverse classification file " << filename
+              << "\n";
+  }
+  PCMS_ALWAYS_ASSERT(fd >= 0);
+  struct stat file_stat;
+  PCMS_ALWAYS_ASSERT(fstat(fd, &file_stat) == 0);
+  const auto file_size = static_cast<size_t>(file_stat.st_size);
+  PCMS_ALWAYS_ASSERT(file_size >= sizeof(ReverseClassificationBinaryHeader));
+  // the CSR views are const, so a read-only mapping is sufficient and the
+  // pages are always shared with the page cache
+  void* mapping = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping stays valid after the file descriptor is closed
+  close(fd);
+  PCMS_ALWAYS_ASSERT(mapping != MAP_FAILED);
+  std::shared_ptr<const void> storage(mapping, [file_size](void* p) {
+    munmap(p, file_size);
+  });
+
+  ReverseClassificationBinaryHeader header;
+  std::memcpy(&header, mapping, sizeof(header));
+  if (std::memcmp(header.magic, rc_binary_magic, sizeof(header.magic)) != 0) {
+    std::cerr << filename << " is not a binary reverse classification file\n";
+  }
+  PCMS_ALWAYS_ASSERT(std::memcmp(header.magic, rc_binary_magic,
+                                 sizeof(header.magic)) == 0);
+  PCMS_ALWAYS_ASSERT(header.version == rc_binary_version);
+  PCMS_ALWAYS_ASSERT(header.lo_size == sizeof(LO));
+  const auto num_geometry = header.num_geometry;
+  const auto num_verts = header.num_verts;
+  PCMS_ALWAYS_ASSERT(file_size == sizeof(header) +
+                                    num_geometry * sizeof(DimID) +
+                                    (num_geometry + 1 + num_verts) * sizeof(LO));
+
+  const auto* bytes = static_cast<const char*>(mapping) + sizeof(header);
+  const auto* geometry_data = reinterpret_cast<const DimID*>(bytes);
+  const auto* offsets_data =
+    reinterpret_cast<const LO*>(bytes + num_geometry * sizeof(DimID));
+  const auto* verts_data = offsets_data + num_geometry + 1;
+  using CSR = ReverseClassificationVertexCSR<HostMemorySpace>;
+  return CSR{typename CSR::GeometryView(geometry_data, num_geometry),
+             typename CSR::IndexView(offsets_data, num_geometry + 1),
+             typename CSR::IndexView(verts_data, num_verts),
+             std::move(storage)};
+}
+
+ReverseClassificationVertexCSR<HostMemorySpace>
+ReadReverseClassificationVertexCSR(std::istream& instr, MPI_Comm comm,
+                                   int root)
+{
+  PCMS_FUNCTION_TIMER;
+  using CSR = ReverseClassificationVertexCSR<HostMemorySpace>;
+  int rank = -1;
+  MPI_Comm_rank(comm, &rank);
+  CSR root_rc;
+  // number of geometric entities and vertices
+  std::array<uint64_t, 2> sizes{0, 0};
+  if (rank == root) {
+    root_rc = CSR{ReadReverseClassificationVertex(instr)};
+    sizes = {static_cast<uint64_t>(root_rc.GetNumGeometricEntities()),
+             static_cast<uint64_t>(root_rc.GetTotalVerts())};
+  }
+  MPI_Bcast(sizes.data(), sizes.size(), MPI_UINT64_T, root, comm);
+  const auto [num_geometry, num_verts] = sizes;
+  const size_t geometry_bytes = num_geometry * sizeof(DimID);
+  const size_t offsets_bytes = (num_geometry + 1) * sizeof(LO);
+  const size_t verts_bytes = num_verts * sizeof(LO);
+  auto* window_ptr = new NodeSharedMemoryWindow(
+    comm, geometry_bytes + offsets_bytes + verts_bytes);
+  std::shared_ptr<NodeSharedMemoryWindow> window(
+    window_ptr, ReverseClassificationWindowDeleter{window_ptr});
+  auto* bytes = static_cast<char*>(window->Data());
+  auto* geometry_data = reinterpret_cast<DimID*>(bytes);
+  auto* offsets_data = reinterpret_cast<LO*>(bytes + geometry_bytes);
+  auto* verts_data =
+    reinterpret_cast<LO*>(bytes + geometry_bytes + offsets_bytes);
+  if (rank == root) {
+    std::copy_n(root_rc.GetGeometry().data(), num_geometry, geometry_data);
+    std::copy_n(root_rc.GetOffsets().data(), num_geometry + 1, offsets_data);
+    std::copy_n(root_rc.GetVerts().data(), num_verts, verts_data);
+  }
+  window->Synchronize();
+  // the leader of the node containing the root is the broadcast root of the
+  // leader communicator
+  int node_has_root = (rank == root);
+  MPI_Allreduce(MPI_IN_PLACE, &node_has_root, 1, MPI_INT, MPI_MAX,
+                window->GetNodeComm());
+  if (window->IsNodeLeader()) {
+    int leader_rank = -1;
+    MPI_Comm_rank(window->GetLeaderComm(), &leader_rank);
+    int leader_root = node_has_root ? leader_rank : -1;
+    MPI_Allreduce(MPI_IN_PLACE, &leader_root, 1, MPI_INT, MPI_MAX,
+                  window->GetLeaderComm());
+    BroadcastBytes(bytes, window->Size(), leader_root,
+                   window->GetLeaderComm());
+  }
+  window->Synchronize();
+  return CSR{typename CSR::GeometryView(geometry_data, num_geometry),
+             typename CSR::IndexView(offsets_data, num_geometry + 1),
+             typename CSR::IndexView(verts_data, num_verts),
+             std::move(window)};
+}
+
+ReverseClassificationVertexCSR<HostMemorySpace>
+ReadReverseClassificationVertexCSR(const std::string& classification_file,
+                                   MPI_Comm comm, int root)
+{
+  int rank = -1;
+  MPI_Comm_rank(comm, &rank);
+  std::ifstream infile;
+  // only the root rank reads the file
+  if (rank == root) {
+    infile.open(classification_file);
+    if (!infile.is_open()) {
+      std::cerr << "Cannot open reverse classification file "
+                << classification_file << "\n";
+    }
+    PCMS_ALWAYS_ASSERT(infile.is_open());
+  }
+  return ReadReverseClassificationVertexCSR(infile, comm, root);
+}
+
+void FreeReverseClassificationVertexCSR(
+  const ReverseClassificationVertexCSR<HostMemorySpace>& rc)
+{
+  PCMS_FUNCTION_TIMER;
+  auto* deleter =
+    std::get_deleter<ReverseClassificationWindowDeleter>(rc.GetStorage());
+  if (deleter == nullptr) {
+    std::cerr << "reverse classification is not stored in a node shared "
+                 "memory window\n";
+  }
+  PCMS_ALWAYS_ASSERT(deleter != nullptr);
+  deleter->window->Free();
+}
+
 } // namespace pcms
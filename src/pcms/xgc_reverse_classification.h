@@ -1,6 +1,7 @@
 #ifndef PCMS_COUPLING_XGC_REVERSE_CLASSIFICATION_H
 #define PCMS_COUPLING_XGC_REVERSE_CLASSIFICATION_H
 #include <Kokkos_Core.hpp>
+#include <Kokkos_Sort.hpp>
 #include <mpi.h>
 #include "pcms/types.h"
 #include <unordered_map>
@@ -8,10 +9,14 @@
 #include "pcms/external/mdspan.hpp"
 #include "pcms/arrays.h"
 #include "pcms/memory_spaces.h"
+#include "pcms/assert.h"
+#include "pcms/profile.h"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
 //#include <filesystem>
 #ifdef PCMS_HAS_OMEGA_H
 #include <Omega_h_mesh.hpp>
-#include "pcms/assert.h"
 #endif
 
 namespace pcms
@@ -42,6 +47,39 @@ struct hash<pcms::DimID>
 } // namespace std
 namespace pcms
 {
+namespace detail
+{
+KOKKOS_INLINE_FUNCTION
+bool dim_id_less(const DimID& a, const DimID& b)
+{
+  return (a.dim < b.dim) || ((a.dim == b.dim) && (a.id < b.id));
+}
+// keys used to sort the reverse classification have the geometric dimension
+// in the top 2 bits, followed by 31 bits for the geometric id and 31 bits for
+// the vertex id
+KOKKOS_INLINE_FUNCTION
+uint64_t pack_rc_key(LO dim, LO id, LO vert)
+{
+  return (static_cast<uint64_t>(dim) << 62) |
+         (static_cast<uint64_t>(id) << 31) | static_cast<uint64_t>(vert);
+}
+KOKKOS_INLINE_FUNCTION
+uint64_t rc_key_geometry(uint64_t key)
+{
+  return key >> 31;
+}
+KOKKOS_INLINE_FUNCTION
+LO rc_key_vert(uint64_t key)
+{
+  return static_cast<LO>(key & ((uint64_t{1} << 31) - 1));
+}
+KOKKOS_INLINE_FUNCTION
+DimID rc_key_dim_id(uint64_t key)
+{
+  return {static_cast<LO>(key >> 62),
+          static_cast<LO>((key >> 31) & ((uint64_t{1} << 31) - 1))};
+}
+} // namespace detail
 ///
 /// This datastructure represents the reverse classification
 /// of the mesh verticies on the geometric entities
@@ -86,6 +124,376 @@ ReverseClassificationVertex ReadReverseClassificationVertex(std::istream&,
                                                             int root = 0);
 ReverseClassificationVertex ReadReverseClassificationVertex(std::string, MPI_Comm, int root = 0);
 
+///
+/// Compressed sparse row (CSR) form of the reverse classification of the mesh
+/// vertices on the geometric entities. The geometric entities are stored in
+/// ascending (dim, id) order and the vertices classified on each entity are
+/// stored contiguously in ascending order, so the iteration order matches
+/// ReverseClassificationVertex. The data is held in Kokkos views, so the
+/// class is cheap to copy and can be captured in kernels that run in
+/// MemorySpace. The arrays are immutable after construction, which allows
+/// them to alias read-only storage such as a memory mapped file.
+template <typename MemorySpace = HostMemorySpace>
+class ReverseClassificationVertexCSR
+{
+public:
+  using memory_space = MemorySpace;
+  using GeometryView = Kokkos::View<const DimID*, MemorySpace>;
+  using IndexView = Kokkos::View<const LO*, MemorySpace>;
+
+  ReverseClassificationVertexCSR() = default;
+  /// construct from existing CSR arrays. The geometric entities must be
+  /// sorted by (dim, id) and offsets must have one more entry than geometry
+  /// storage is kept alive for the lifetime of the CSR and any copies
+  /// and can be used when the views do not own their memory
+  ReverseClassificationVertexCSR(GeometryView geometry, IndexView offsets,
+                                 IndexView verts,
+                                 std::shared_ptr<const void> storage = nullptr)
+    : geometry_(std::move(geometry)),
+      offsets_(std::move(offsets)),
+      verts_(std::move(verts)),
+      storage_(std::move(storage))
+  {
+    PCMS_ALWAYS_ASSERT(offsets_.extent(0) == geometry_.extent(0) + 1);
+  }
+  explicit ReverseClassificationVertexCSR(const ReverseClassificationVertex& rc)
+  {
+    PCMS_FUNCTION_TIMER;
+    std::vector<std::pair<DimID, const std::set<LO>*>> entities;
+    entities.reserve(std::distance(rc.begin(), rc.end()));
+    for (const auto& geom : rc) {
+      entities.emplace_back(geom.first, &geom.second);
+    }
+    std::sort(entities.begin(), entities.end(),
+              [](const auto& a, const auto& b) {
+                return detail::dim_id_less(a.first, b.first);
+              });
+    auto geometry_h = Kokkos::View<DimID*, HostMemorySpace>(
+      Kokkos::ViewAllocateWithoutInitializing("geometry"), entities.size());
+    auto offsets_h = Kokkos::View<LO*, HostMemorySpace>("offsets",
+                                                      entities.size() + 1);
+    for (size_t i = 0; i < entities.size(); ++i) {
+      geometry_h(i) = entities[i].first;
+      offsets_h(i + 1) = offsets_h(i) + entities[i].second->size();
+    }
+    auto verts_h = Kokkos::View<LO*, HostMemorySpace>(
+      Kokkos::ViewAllocateWithoutInitializing("verts"),
+      offsets_h(entities.size()));
+    for (size_t i = 0; i < entities.size(); ++i) {
+      std::copy(entities[i].second->begin(), entities[i].second->end(),
+                verts_h.data() + offsets_h(i));
+    }
+    SetFromHost(geometry_h, offsets_h, verts_h);
+  }
+  /// construct a CSR reverse classification with a copy of the data in
+  /// another memory space
+  template <typename OtherMemorySpace>
+  explicit ReverseClassificationVertexCSR(
+    const ReverseClassificationVertexCSR<OtherMemorySpace>& other)
+    : geometry_(Kokkos::create_mirror_view_and_copy(MemorySpace{},
+                                                    other.GetGeometry())),
+      offsets_(
+        Kokkos::create_mirror_view_and_copy(MemorySpace{}, other.GetOffsets())),
+      verts_(
+        Kokkos::create_mirror_view_and_copy(MemorySpace{}, other.GetVerts())),
+      // if the memory spaces match the views alias the storage of other
+      storage_(other.GetStorage())
+  {
+  }
+
+  /// number of geometric entities that have classified vertices
+  [[nodiscard]] KOKKOS_INLINE_FUNCTION LO GetNumGeometricEntities() const
+  {
+    return geometry_.extent(0);
+  }
+  [[nodiscard]] KOKKOS_INLINE_FUNCTION LO GetTotalVerts() const
+  {
+    return verts_.extent(0);
+  }
+  /// index of the geometric entity in the CSR arrays or -1 if no vertices
+  /// are classified on the entity
+  [[nodiscard]] KOKKOS_INLINE_FUNCTION LO Find(const DimID& geometry) const
+  {
+    LO first = 0;
+    LO last = geometry_.extent(0);
+    while (first < last) {
+      const LO mid = first + (last - first) / 2;
+      if (detail::dim_id_less(geometry_(mid), geometry)) {
+        first = mid + 1;
+      } else {
+        last = mid;
+      }
+    }
+    if (first < static_cast<LO>(geometry_.extent(0)) &&
+        geometry_(first).dim == geometry.dim &&
+        geometry_(first).id == geometry.id) {
+      return first;
+    }
+    return -1;
+  }
+  /// vertices classified on the geometric entity. Empty if no vertices are
+  /// classified on the entity
+  [[nodiscard]] ScalarArrayView<const LO, MemorySpace> Query(
+    const DimID& geometry) const
+  {
+    const auto idx = Find(geometry);
+    if (idx < 0) {
+      return {};
+    }
+    return GetEntityVerts(idx);
+  }
+  [[nodiscard]] ScalarArrayView<const LO, MemorySpace> GetEntityVerts(
+    LO idx) const
+  {
+    static_assert(
+      Kokkos::SpaceAccessibility<Kokkos::HostSpace, MemorySpace>::accessible,
+      "offsets must be host accessible");
+    return {verts_.data() + offsets_(idx), offsets_(idx + 1) - offsets_(idx)};
+  }
+  [[nodiscard]] const GeometryView& GetGeometry() const noexcept
+  {
+    return geometry_;
+  }
+  [[nodiscard]] const IndexView& GetOffsets() const noexcept
+  {
+    return offsets_;
+  }
+  [[nodiscard]] const IndexView& GetVerts() const noexcept { return verts_; }
+  [[nodiscard]] const std::shared_ptr<const void>& GetStorage() const noexcept
+  {
+    return storage_;
+  }
+
+  /// serialize into the same format as ReverseClassificationVertex
+  [[nodiscard]] std::vector<LO> Serialize() const
+  {
+    PCMS_FUNCTION_TIMER;
+    auto geometry_h =
+      Kokkos::create_mirror_view_and_copy(HostMemorySpace{}, geometry_);
+    auto offsets_h =
+      Kokkos::create_mirror_view_and_copy(HostMemorySpace{}, offsets_);
+    auto verts_h = Kokkos::create_mirror_view_and_copy(HostMemorySpace{}, verts_);
+    std::vector<LO> serialized_data;
+    serialized_data.reserve(3 * geometry_h.extent(0) + verts_h.extent(0));
+    for (size_t i = 0; i < geometry_h.extent(0); ++i) {
+      serialized_data.push_back(geometry_h(i).dim);
+      serialized_data.push_back(geometry_h(i).id);
+      serialized_data.push_back(offsets_h(i + 1) - offsets_h(i));
+      std::copy(verts_h.data() + offsets_h(i), verts_h.data() + offsets_h(i + 1),
+                std::back_inserter(serialized_data));
+    }
+    return serialized_data;
+  }
+  /// deserialize data in the format produced by
+  /// ReverseClassificationVertex::Serialize directly into the CSR arrays
+  void Deserialize(ScalarArrayView<const LO, HostMemorySpace> serialized_data)
+  {
+    PCMS_FUNCTION_TIMER;
+    // expect to deserialize into an empty reverse classification class
+    PCMS_ALWAYS_ASSERT(GetNumGeometricEntities() == 0);
+    struct Entry
+    {
+      DimID geometry;
+      size_t begin;
+      LO nverts;
+    };
+    std::vector<Entry> entries;
+    size_t total_verts = 0;
+    size_t i = 0;
+    while (i < serialized_data.size()) {
+      PCMS_ALWAYS_ASSERT(i + 2 < serialized_data.size());
+      const auto nverts = serialized_data[i + 2];
+      entries.push_back(
+        {{serialized_data[i], serialized_data[i + 1]}, i + 3, nverts});
+      total_verts += nverts;
+      i += 3 + nverts;
+    }
+    PCMS_ALWAYS_ASSERT(i == serialized_data.size());
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry& a, const Entry& b) {
+                return detail::dim_id_less(a.geometry, b.geometry);
+              });
+    auto geometry_h = Kokkos::View<DimID*, HostMemorySpace>(
+      Kokkos::ViewAllocateWithoutInitializing("geometry"), entries.size());
+    auto offsets_h =
+      Kokkos::View<LO*, HostMemorySpace>("offsets", entries.size() + 1);
+    auto verts_h = Kokkos::View<LO*, HostMemorySpace>(
+      Kokkos::ViewAllocateWithoutInitializing("verts"), total_verts);
+    for (size_t j = 0; j < entries.size(); ++j) {
+      const auto& entry = entries[j];
+      geometry_h(j) = entry.geometry;
+      offsets_h(j + 1) = offsets_h(j) + entry.nverts;
+      auto* row = verts_h.data() + offsets_h(j);
+      std::copy_n(serialized_data.data_handle() + entry.begin, entry.nverts,
+                  row);
+      std::sort(row, row + entry.nverts);
+    }
+    SetFromHost(geometry_h, offsets_h, verts_h);
+  }
+  [[nodiscard]] bool operator==(const ReverseClassificationVertexCSR& other) const
+  {
+    auto equal = [](const auto& a, const auto& b) {
+      auto a_h = Kokkos::create_mirror_view_and_copy(HostMemorySpace{}, a);
+      auto b_h = Kokkos::create_mirror_view_and_copy(HostMemorySpace{}, b);
+      return std::equal(a_h.data(), a_h.data() + a_h.size(), b_h.data(),
+                        b_h.data() + b_h.size());
+    };
+    return equal(geometry_, other.geometry_) &&
+           equal(offsets_, other.offsets_) && equal(verts_, other.verts_);
+  }
+
+private:
+  template <typename G, typename O, typename V>
+  void SetFromHost(const G& geometry_h, const O& offsets_h, const V& verts_h)
+  {
+    geometry_ = Kokkos::create_mirror_view_and_copy(MemorySpace{}, geometry_h);
+    offsets_ = Kokkos::create_mirror_view_and_copy(MemorySpace{}, offsets_h);
+    verts_ = Kokkos::create_mirror_view_and_copy(MemorySpace{}, verts_h);
+    storage_.reset();
+  }
+  GeometryView geometry_;
+  IndexView offsets_;
+  IndexView verts_;
+  std::shared_ptr<const void> storage_;
+};
+
+/**
+ * Write the reverse classification in the binary format. The file consists
+ * of a fixed size header followed by the geometry (dim, id pairs), offsets,
+ * and vertex arrays of the CSR structure in native byte order. Since the
+ * arrays are stored exactly as they are used, the file can be memory mapped
+ * without any parsing.
+ */
+void WriteReverseClassificationVertexBinary(
+  const ReverseClassificationVertexCSR<HostMemorySpace>& rc,
+  const std::string& filename);
+/**
+ * Memory map a reverse classification file written with
+ * WriteReverseClassificationVertexBinary. The returned views point directly
+ * into the read-only mapping, which stays open until the last copy of the
+ * reverse classification is destroyed. Since the pages are shared through
+ * the page cache, all ranks on a node can map the same file rather than
+ * receiving a broadcast.
+ */
+[[nodiscard]] ReverseClassificationVertexCSR<HostMemorySpace>
+MapReverseClassificationVertexBinary(const std::string& filename);
+/**
+ * Read the text reverse classification on the root rank and distribute it
+ * to all ranks of comm. The CSR arrays are broadcast in chunks with 64 bit
+ * sizes directly into a single shared memory copy per node, so the memory use
+ * per node does not grow with the number of ranks and no ranks other than
+ * the root need to parse or rebuild the data.
+ *
+ * \Warning the returned data is backed by a NodeSharedMemoryWindow that must
+ * be released with FreeReverseClassificationVertexCSR, collectively over comm,
+ * once the reverse classification and all of its copies (e.g., in field
+ * adapters) are no longer used. If it is never freed, destroying the last
+ * copy releases the window, which is only safe if every rank destroys its
+ * copies in the same order.
+ */
+[[nodiscard]] ReverseClassificationVertexCSR<HostMemorySpace>
+ReadReverseClassificationVertexCSR(std::istream&, MPI_Comm, int root = 0);
+[[nodiscard]] ReverseClassificationVertexCSR<HostMemorySpace>
+ReadReverseClassificationVertexCSR(const std::string&, MPI_Comm,
+                                   int root = 0);
+/**
+ * Release the node shared memory of a reverse classification returned by
+ * ReadReverseClassificationVertexCSR. Collective over the communicator it was
+ * read on. The views of rc and all of its copies dangle afterwards, but the
+ * copies can be destroyed in any order without communication.
+ */
+void FreeReverseClassificationVertexCSR(
+  const ReverseClassificationVertexCSR<HostMemorySpace>& rc);
+
+/**
+ * Construct the CSR reverse classification in parallel from the
+ * classification of each vertex. Duplicate (geometry, vertex) entries are
+ * removed.
+ *
+ * @param class_dims dimension of the geometric entity each vertex is
+ * classified on (0-3)
+ * @param class_ids non-negative id of the geometric entity each vertex is
+ * classified on
+ * @param vert_ids non-negative id of each vertex
+ */
+template <typename MemorySpace>
+[[nodiscard]] ReverseClassificationVertexCSR<MemorySpace>
+ConstructReverseClassificationCSR(
+  Kokkos::View<const LO*, MemorySpace> class_dims,
+  Kokkos::View<const LO*, MemorySpace> class_ids,
+  Kokkos::View<const LO*, MemorySpace> vert_ids)
+{
+  PCMS_FUNCTION_TIMER;
+  using execution_space = typename MemorySpace::execution_space;
+  const auto n = vert_ids.extent(0);
+  PCMS_ALWAYS_ASSERT(class_dims.extent(0) == n && class_ids.extent(0) == n);
+  // pack (dim, id, vert) into a single key so a single sort orders the
+  // vertices by geometric entity and by vertex id within each entity
+  Kokkos::View<uint64_t*, MemorySpace> keys(
+    Kokkos::ViewAllocateWithoutInitializing("keys"), n);
+  Kokkos::parallel_for(
+    Kokkos::RangePolicy<execution_space>(0, n), KOKKOS_LAMBDA(LO i) {
+      KOKKOS_ASSERT(class_dims(i) >= 0 && class_dims(i) <= 3);
+      KOKKOS_ASSERT(class_ids(i) >= 0 && vert_ids(i) >= 0);
+      keys(i) = detail::pack_rc_key(class_dims(i), class_ids(i), vert_ids(i));
+    });
+  Kokkos::sort(keys);
+  // exclusive scans give the position of each unique vertex and each new
+  // geometric entity
+  Kokkos::View<LO*, MemorySpace> vert_index(
+    Kokkos::ViewAllocateWithoutInitializing("vert index"), n);
+  Kokkos::View<LO*, MemorySpace> geom_index(
+    Kokkos::ViewAllocateWithoutInitializing("geom index"), n);
+  Kokkos::View<LO[2], MemorySpace> totals("totals");
+  Kokkos::parallel_scan(
+    Kokkos::RangePolicy<execution_space>(0, n),
+    KOKKOS_LAMBDA(LO i, LO & update, bool final) {
+      const LO unique = (i == 0) || (keys(i) != keys(i - 1));
+      if (final) {
+        vert_index(i) = unique ? update : -1;
+        if (i == static_cast<LO>(n) - 1) {
+          totals(0) = update + unique;
+        }
+      }
+      update += unique;
+    });
+  Kokkos::parallel_scan(
+    Kokkos::RangePolicy<execution_space>(0, n),
+    KOKKOS_LAMBDA(LO i, LO & update, bool final) {
+      const LO new_geom =
+        (i == 0) || (detail::rc_key_geometry(keys(i)) !=
+                     detail::rc_key_geometry(keys(i - 1)));
+      if (final) {
+        geom_index(i) = new_geom ? update : -1;
+        if (i == static_cast<LO>(n) - 1) {
+          totals(1) = update + new_geom;
+        }
+      }
+      update += new_geom;
+    });
+  auto totals_h = Kokkos::create_mirror_view_and_copy(HostMemorySpace{}, totals);
+  Kokkos::View<DimID*, MemorySpace> geometry(
+    Kokkos::ViewAllocateWithoutInitializing("geometry"), totals_h(1));
+  Kokkos::View<LO*, MemorySpace> offsets("offsets", totals_h(1) + 1);
+  Kokkos::View<LO*, MemorySpace> verts(
+    Kokkos::ViewAllocateWithoutInitializing("verts"), totals_h(0));
+  Kokkos::parallel_for(
+    Kokkos::RangePolicy<execution_space>(0, n), KOKKOS_LAMBDA(LO i) {
+      const auto key = keys(i);
+      if (vert_index(i) >= 0) {
+        verts(vert_index(i)) = detail::rc_key_vert(key);
+      }
+      if (geom_index(i) >= 0) {
+        geometry(geom_index(i)) = detail::rc_key_dim_id(key);
+        offsets(geom_index(i)) = vert_index(i);
+      }
+      if (i == 0) {
+        offsets(totals(1)) = totals(0);
+      }
+    });
+  return {geometry, offsets, verts};
+}
+
 #ifdef PCMS_HAS_OMEGA_H
 enum class IndexBase {
   Zero = 0,
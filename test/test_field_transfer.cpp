@@ -4,6 +4,8 @@
 #include <Omega_h_mesh.hpp>
 #include <Omega_h_build.hpp>
 #include <Kokkos_Core.hpp>
+#include <thread>
+#include <vector>
 
 TEST_CASE("field copy", "[field transfer]")
 {
@@ -66,3 +68,175 @@ TEST_CASE("field interpolation (identical fields)", "[field transfer]")
     REQUIRE(result == n * (n + 1) / 2);
   }
 }
+
+TEST_CASE("cached interpolation stencils", "[field transfer]")
+{
+  Omega_h::Library lib;
+  auto mesh =
+    Omega_h::build_box(lib.world(), OMEGA_H_SIMPLEX, 1, 1, 1, 10, 10, 0, false);
+  pcms::OmegaHField<pcms::LO> f1("source", mesh);
+  Omega_h::Write<int> data(mesh.nents(0));
+  Omega_h::parallel_for(
+    data.size(), OMEGA_H_LAMBDA(int i) { data[i] = i; });
+  mesh.add_tag<pcms::LO>(0, "source", 1, data);
+  pcms::OmegaHField<pcms::LO> f2("target", mesh);
+  auto coordinates = pcms::get_nodal_coordinates(f2);
+  auto stencil = f1.GetStencil(pcms::make_const_array_view(coordinates));
+  // the same coordinates in a different array reuse the stencil
+  Omega_h::Reals copied_coordinates(Omega_h::deep_copy(coordinates));
+  auto cached =
+    f1.GetStencil(pcms::make_const_array_view(copied_coordinates));
+  REQUIRE(cached.data() == stencil.data());
+  // different coordinates are searched again
+  Omega_h::Write<Omega_h::Real> shifted(coordinates.size());
+  Omega_h::parallel_for(
+    shifted.size(), OMEGA_H_LAMBDA(int i) { shifted[i] = coordinates[i] / 2; });
+  Omega_h::Reals shifted_coordinates(shifted);
+  auto shifted_stencil =
+    f1.GetStencil(pcms::make_const_array_view(shifted_coordinates));
+  REQUIRE(shifted_stencil.data() != stencil.data());
+  pcms::interpolate_field(f1, f2, pcms::Lagrange<1>{});
+  pcms::interpolate_field(f1, f2, pcms::Lagrange<1>{});
+  auto target_array = mesh.get_array<int>(0, "target");
+  auto n = target_array.size() - 1;
+  REQUIRE(sum_array(target_array) == n * (n + 1) / 2);
+}
+
+TEST_CASE("stencil cache compares coordinates", "[field transfer]")
+{
+  pcms::detail::StencilCache cache;
+  Kokkos::View<pcms::Real*> a("a", 4);
+  Kokkos::View<pcms::Real*> b("b", 4);
+  Kokkos::deep_copy(a, 1.0);
+  Kokkos::deep_copy(b, 2.0);
+  int computed = 0;
+  auto compute = [&computed]() {
+    ++computed;
+    return pcms::detail::StencilCache::Stencil("stencil", 2);
+  };
+  // coordinates of the same size with a colliding hash are not a hit
+  auto stencil_a =
+    cache.GetOrCompute(Kokkos::View<const pcms::Real*>(a), 42, compute);
+  auto stencil_b =
+    cache.GetOrCompute(Kokkos::View<const pcms::Real*>(b), 42, compute);
+  REQUIRE(computed == 2);
+  REQUIRE(stencil_a.data() != stencil_b.data());
+  // the cached copy is unaffected by later changes to the input array
+  Kokkos::deep_copy(a, 2.0);
+  auto cached =
+    cache.GetOrCompute(Kokkos::View<const pcms::Real*>(a), 42, compute);
+  REQUIRE(computed == 2);
+  REQUIRE(cached.data() == stencil_b.data());
+}
+
+TEST_CASE("multi-field interpolation", "[field transfer]")
+{
+  using Field = pcms::OmegaHField<pcms::LO>;
+  Omega_h::Library lib;
+  auto mesh =
+    Omega_h::build_box(lib.world(), OMEGA_H_SIMPLEX, 1, 1, 1, 10, 10, 0, false);
+  Omega_h::Write<int> data(mesh.nents(0));
+  Omega_h::parallel_for(
+    data.size(), OMEGA_H_LAMBDA(int i) { data[i] = i; });
+  mesh.add_tag<pcms::LO>(0, "source1", 1, data);
+  Omega_h::Write<int> data2(mesh.nents(0));
+  Omega_h::parallel_for(
+    data2.size(), OMEGA_H_LAMBDA(int i) { data2[i] = 2 * i; });
+  mesh.add_tag<pcms::LO>(0, "source2", 1, data2);
+  Field s1("source1", mesh);
+  Field s2("source2", mesh);
+  Field t1("target1", mesh);
+  Field t2("target2", mesh);
+  std::vector<std::reference_wrapper<const Field>> sources{s1, s2};
+  std::vector<std::reference_wrapper<Field>> targets{t1, t2};
+  auto n = mesh.nents(0) - 1;
+  SECTION("Lagrange<1>")
+  {
+    pcms::interpolate_fields<Field, Field>(sources, targets,
+                                           pcms::Lagrange<1>{});
+  }
+  SECTION("Nearest Neighbor")
+  {
+    pcms::interpolate_fields<Field, Field>(sources, targets,
+                                           pcms::NearestNeighbor{});
+  }
+  REQUIRE(sum_array(mesh.get_array<int>(0, "target1")) == n * (n + 1) / 2);
+  REQUIRE(sum_array(mesh.get_array<int>(0, "target2")) == n * (n + 1));
+}
+
+TEST_CASE("fields share a lazily constructed search", "[field transfer]")
+{
+  Omega_h::Library lib;
+  auto mesh =
+    Omega_h::build_box(lib.world(), OMEGA_H_SIMPLEX, 1, 1, 1, 10, 10, 0, false);
+  Omega_h::Write<int> data(mesh.nents(0));
+  Omega_h::parallel_for(
+    data.size(), OMEGA_H_LAMBDA(int i) { data[i] = i; });
+  mesh.add_tag<pcms::LO>(0, "source", 1, data);
+  pcms::OmegaHField<pcms::LO> f1("source", mesh);
+  pcms::OmegaHField<pcms::Real> f2("target", mesh);
+  REQUIRE(f1.GetMeshSearch() == f2.GetMeshSearch());
+  REQUIRE(f1.GetMeshSearch() == pcms::get_mesh_search(mesh));
+  // a different grid size is a different search
+  REQUIRE(f1.GetMeshSearch() != pcms::get_mesh_search(mesh, 5, 5));
+  REQUIRE(!f1.GetMeshSearch()->IsConstructed());
+  pcms::OmegaHField<pcms::LO> f3("copy", mesh);
+  pcms::copy_field(f1, f3);
+  REQUIRE(!f1.GetMeshSearch()->IsConstructed());
+  pcms::OmegaHField<pcms::LO> f4("interpolated", mesh);
+  pcms::interpolate_field(f1, f4);
+  REQUIRE(f1.GetMeshSearch()->IsConstructed());
+  // replacing the coordinates invalidates the search
+  const auto search = f1.GetMeshSearch();
+  mesh.set_coords(Omega_h::Reals(Omega_h::deep_copy(mesh.coords())));
+  REQUIRE(!search->IsCurrent());
+  REQUIRE(pcms::get_mesh_search(mesh) != search);
+  pcms::interpolate_field(f1, f4);
+  REQUIRE(search->IsCurrent());
+  REQUIRE(search->IsConstructed());
+}
+
+TEST_CASE("mesh search is used from several threads", "[field transfer]")
+{
+  Omega_h::Library lib;
+  auto mesh =
+    Omega_h::build_box(lib.world(), OMEGA_H_SIMPLEX, 1, 1, 1, 10, 10, 0, false);
+  pcms::OmegaHField<pcms::Real> field("field", mesh);
+  auto coordinates = pcms::get_nodal_coordinates(field);
+  const auto npoints = coordinates.size() / 2;
+  Kokkos::View<pcms::Real* [2]> points("points", npoints);
+  Kokkos::parallel_for(
+    npoints, KOKKOS_LAMBDA(int i) {
+      // move the points off of the vertices
+      points(i, 0) = 0.9 * coordinates[2 * i] + 0.05;
+      points(i, 1) = 0.9 * coordinates[2 * i + 1] + 0.03;
+    });
+  // the threads race to construct the search and the stencil
+  constexpr int nthreads = 4;
+  std::vector<Kokkos::View<pcms::GridPointSearch::Result*>> results(nthreads);
+  std::vector<pcms::detail::StencilCache::Stencil> stencils(nthreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < nthreads; ++t) {
+    threads.emplace_back([&, t]() {
+      results[t] = field.Search(points);
+      stencils[t] = field.GetStencil(pcms::make_const_array_view(coordinates));
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  REQUIRE(field.GetMeshSearch()->IsConstructed());
+  const auto expected = Kokkos::create_mirror_view_and_copy(
+    Kokkos::HostSpace{}, field.Search(points));
+  for (int t = 0; t < nthreads; ++t) {
+    // every thread gets the stencil that was cached by the first
+    REQUIRE(stencils[t].data() == stencils[0].data());
+    const auto results_h =
+      Kokkos::create_mirror_view_and_copy(Kokkos::HostSpace{}, results[t]);
+    REQUIRE(results_h.extent(0) == expected.extent(0));
+    for (size_t p = 0; p < expected.extent(0); ++p) {
+      REQUIRE(results_h(p).Inside());
+      REQUIRE(results_h(p).tri_id == expected(p).tri_id);
+    }
+  }
+}
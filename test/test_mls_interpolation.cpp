@@ -0,0 +1,317 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include <Omega_h_library.hpp>
+#include <MLSInterpolation.hpp>
+#include <cmath>
+#include <vector>
+
+static Omega_h::Reals to_reals(const std::vector<Omega_h::Real>& values)
+{
+  Omega_h::HostWrite<Omega_h::Real> values_h(values.size());
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    values_h[i] = values[i];
+  }
+  return Omega_h::Reals(values_h.write());
+}
+
+// points of a lattice with n points in each direction and the given spacing
+// starting at offset
+static std::vector<Omega_h::Real> lattice(int dim, int n, Omega_h::Real offset,
+                                          Omega_h::Real spacing)
+{
+  int npoints = 1;
+  for (int d = 0; d < dim; ++d) {
+    npoints *= n;
+  }
+  std::vector<Omega_h::Real> points(npoints * dim);
+  for (int i = 0; i < npoints; ++i) {
+    int index = i;
+    for (int d = 0; d < dim; ++d) {
+      points[i * dim + d] = offset + (index % n) * spacing;
+      index /= n;
+    }
+  }
+  return points;
+}
+
+// the supports of each target are all of the sources within the cutoff of
+// the target
+static SupportResults brute_force_supports(
+  int dim, const std::vector<Omega_h::Real>& sources,
+  const std::vector<Omega_h::Real>& targets,
+  const std::vector<Omega_h::Real>& cutoffs)
+{
+  const int nsources = sources.size() / dim;
+  const int ntargets = targets.size() / dim;
+  std::vector<Omega_h::LO> supports_ptr(1, 0);
+  std::vector<Omega_h::LO> supports_idx;
+  for (int t = 0; t < ntargets; ++t) {
+    for (int s = 0; s < nsources; ++s) {
+      Omega_h::Real dist2 = 0;
+      for (int d = 0; d < dim; ++d) {
+        const auto dx = sources[s * dim + d] - targets[t * dim + d];
+        dist2 += dx * dx;
+      }
+      if (dist2 < cutoffs[t] * cutoffs[t]) {
+        supports_idx.push_back(s);
+      }
+    }
+    supports_ptr.push_back(supports_idx.size());
+  }
+  Omega_h::HostWrite<Omega_h::LO> supports_ptr_h(supports_ptr.size());
+  for (std::size_t i = 0; i < supports_ptr.size(); ++i) {
+    supports_ptr_h[i] = supports_ptr[i];
+  }
+  Omega_h::HostWrite<Omega_h::LO> supports_idx_h(supports_idx.size());
+  for (std::size_t i = 0; i < supports_idx.size(); ++i) {
+    supports_idx_h[i] = supports_idx[i];
+  }
+  Omega_h::HostWrite<Omega_h::Real> radii2_h(ntargets);
+  for (int t = 0; t < ntargets; ++t) {
+    radii2_h[t] = cutoffs[t] * cutoffs[t];
+  }
+  SupportResults support;
+  support.supports_ptr = supports_ptr_h.write();
+  support.supports_idx = supports_idx_h.write();
+  support.radii2 = radii2_h.write();
+  return support;
+}
+
+static SupportResults brute_force_supports(
+  int dim, const std::vector<Omega_h::Real>& sources,
+  const std::vector<Omega_h::Real>& targets, Omega_h::Real cutoff)
+{
+  return brute_force_supports(
+    dim, sources, targets,
+    std::vector<Omega_h::Real>(targets.size() / dim, cutoff));
+}
+
+TEST_CASE("mls setup and apply", "[interpolator]")
+{
+  Omega_h::Library lib;
+  const auto sources = lattice(2, 11, 0, 0.1);
+  const auto targets = lattice(2, 5, 0.05, 0.2);
+  const int nsources = sources.size() / 2;
+  const auto support = brute_force_supports(2, sources, targets, 0.3);
+  const auto source_coordinates = to_reals(sources);
+  const auto target_coordinates = to_reals(targets);
+
+  std::vector<Omega_h::Real> f(nsources);
+  std::vector<Omega_h::Real> g(nsources);
+  for (int i = 0; i < nsources; ++i) {
+    const auto x = sources[2 * i];
+    const auto y = sources[2 * i + 1];
+    f[i] = std::sin(3 * x) * std::cos(2 * y);
+    g[i] = x * x + y;
+  }
+  const auto f_values = to_reals(f);
+  const auto g_values = to_reals(g);
+
+  const auto mls_operator =
+    mls_setup(source_coordinates, target_coordinates, support, 2, support.radii2);
+  REQUIRE(mls_operator.coefficients.size() == support.supports_idx.size());
+
+  SECTION("apply matches the one shot interpolation")
+  {
+    Omega_h::HostRead<Omega_h::Real> applied(
+      mls_apply(mls_operator, f_values));
+    Omega_h::HostRead<Omega_h::Real> interpolated(
+      mls_interpolation(f_values, source_coordinates, target_coordinates,
+                        support, 2, support.radii2));
+    REQUIRE(applied.size() == interpolated.size());
+    REQUIRE(applied.size() == static_cast<int>(targets.size() / 2));
+    for (int i = 0; i < applied.size(); ++i) {
+      REQUIRE(applied[i] == Catch::Approx(interpolated[i]).margin(1E-12));
+    }
+  }
+  SECTION("one operator is reused for several fields")
+  {
+    Omega_h::HostRead<Omega_h::Real> applied_f(
+      mls_apply(mls_operator, f_values));
+    Omega_h::HostRead<Omega_h::Real> applied_g(
+      mls_apply(mls_operator, g_values));
+    Omega_h::HostRead<Omega_h::Real> interpolated_f(
+      mls_interpolation(f_values, source_coordinates, target_coordinates,
+                        support, 2, support.radii2));
+    Omega_h::HostRead<Omega_h::Real> interpolated_g(
+      mls_interpolation(g_values, source_coordinates, target_coordinates,
+                        support, 2, support.radii2));
+    for (int i = 0; i < applied_f.size(); ++i) {
+      REQUIRE(applied_f[i] == Catch::Approx(interpolated_f[i]).margin(1E-12));
+      REQUIRE(applied_g[i] == Catch::Approx(interpolated_g[i]).margin(1E-12));
+      // the quadratic basis reproduces g exactly
+      const auto x = targets[2 * i];
+      const auto y = targets[2 * i + 1];
+      REQUIRE(applied_g[i] == Catch::Approx(x * x + y).margin(1E-10));
+    }
+  }
+}
+
+// polynomial with every monomial up to the given degree
+static Omega_h::Real polynomial(int dim, int degree, const Omega_h::Real* x)
+{
+  const Omega_h::Real z = (dim == 3) ? x[2] : 0;
+  Omega_h::Real value = 1.5;
+  if (degree >= 1) {
+    value += 2 * x[0] - x[1] + 0.5 * z;
+  }
+  if (degree >= 2) {
+    value += x[0] * x[0] - 3 * x[0] * x[1] + x[1] * x[1] + z * z - x[1] * z;
+  }
+  return value;
+}
+
+// the MLS approximation reproduces every polynomial up to the degree of its
+// basis exactly
+template <int dim, int degree, RadialBasis kind>
+static void check_polynomial_reproduction()
+{
+  const auto sources = lattice(dim, 6, 0, 0.2);
+  const auto targets = lattice(dim, 3, 0.15, 0.3);
+  const int nsources = sources.size() / dim;
+  const int ntargets = targets.size() / dim;
+  const auto support = brute_force_supports(dim, sources, targets, 0.45);
+  const auto mls_operator = mls_setup<degree, kind>(
+    to_reals(sources), to_reals(targets), support, dim, support.radii2);
+  for (int p = 0; p <= degree; ++p) {
+    std::vector<Omega_h::Real> values(nsources);
+    for (int i = 0; i < nsources; ++i) {
+      values[i] = polynomial(dim, p, &sources[i * dim]);
+    }
+    Omega_h::HostRead<Omega_h::Real> approximated(
+      mls_apply(mls_operator, to_reals(values)));
+    REQUIRE(approximated.size() == ntargets);
+    for (int i = 0; i < ntargets; ++i) {
+      REQUIRE(approximated[i] ==
+              Catch::Approx(polynomial(dim, p, &targets[i * dim]))
+                .margin(1E-10));
+    }
+  }
+}
+
+TEST_CASE("mls polynomial reproduction", "[interpolator]")
+{
+  Omega_h::Library lib;
+  SECTION("2D")
+  {
+    check_polynomial_reproduction<2, 0, RadialBasis::Wu>();
+    check_polynomial_reproduction<2, 1, RadialBasis::Wu>();
+    check_polynomial_reproduction<2, 2, RadialBasis::Wu>();
+    check_polynomial_reproduction<2, 0, RadialBasis::WendlandC2>();
+    check_polynomial_reproduction<2, 1, RadialBasis::WendlandC2>();
+    check_polynomial_reproduction<2, 2, RadialBasis::WendlandC2>();
+  }
+  SECTION("3D")
+  {
+    check_polynomial_reproduction<3, 0, RadialBasis::Wu>();
+    check_polynomial_reproduction<3, 1, RadialBasis::Wu>();
+    check_polynomial_reproduction<3, 2, RadialBasis::Wu>();
+    check_polynomial_reproduction<3, 0, RadialBasis::WendlandC2>();
+    check_polynomial_reproduction<3, 1, RadialBasis::WendlandC2>();
+    check_polynomial_reproduction<3, 2, RadialBasis::WendlandC2>();
+  }
+}
+
+TEST_CASE("mls targets with mixed support counts", "[interpolator]")
+{
+  Omega_h::Library lib;
+  const auto sources = lattice(2, 11, 0, 0.1);
+  const auto targets = lattice(2, 5, 0.05, 0.2);
+  const int ntargets = targets.size() / 2;
+  // the cutoffs give from 8 to more than 100 supports, so the targets are
+  // spread over several buckets of the coefficient launches
+  std::vector<Omega_h::Real> cutoffs(ntargets);
+  for (int t = 0; t < ntargets; ++t) {
+    cutoffs[t] = 0.3 + 0.1 * (t % 4);
+  }
+  const auto support = brute_force_supports(2, sources, targets, cutoffs);
+  Omega_h::HostRead<Omega_h::LO> supports_ptr(support.supports_ptr);
+
+  SECTION("coefficients do not depend on the bucketing")
+  {
+    const auto mls_operator = mls_setup(to_reals(sources), to_reals(targets),
+                                        support, 2, support.radii2);
+    Omega_h::HostRead<Omega_h::Real> coefficients(mls_operator.coefficients);
+    // each target on its own is the only target of its bucket
+    for (int t = 0; t < ntargets; ++t) {
+      const std::vector<Omega_h::Real> target(targets.begin() + 2 * t,
+                                              targets.begin() + 2 * (t + 1));
+      const auto target_support =
+        brute_force_supports(2, sources, target, cutoffs[t]);
+      const auto target_operator =
+        mls_setup(to_reals(sources), to_reals(target), target_support, 2,
+                  target_support.radii2);
+      Omega_h::HostRead<Omega_h::Real> target_coefficients(
+        target_operator.coefficients);
+      REQUIRE(target_coefficients.size() ==
+              supports_ptr[t + 1] - supports_ptr[t]);
+      for (int j = 0; j < target_coefficients.size(); ++j) {
+        REQUIRE(coefficients[supports_ptr[t] + j] ==
+                Catch::Approx(target_coefficients[j]).margin(1E-12));
+      }
+    }
+  }
+#ifdef OMEGA_H_THROW
+  // without exceptions Omega_h_fail aborts, which cannot be tested here
+  SECTION("too few supports for the basis fail")
+  {
+    const std::vector<Omega_h::Real> corner{0.05, 0.05};
+    // three supports of the corner target determine a linear basis but not a
+    // quadratic one
+    const auto corner_support =
+      brute_force_supports(2, sources, corner, 0.16);
+    REQUIRE(Omega_h::HostRead<Omega_h::LO>(corner_support.supports_ptr)[1] ==
+            3);
+    REQUIRE_THROWS(mls_setup(to_reals(sources), to_reals(corner),
+                             corner_support, 2, corner_support.radii2));
+    REQUIRE_NOTHROW(mls_setup<1>(to_reals(sources), to_reals(corner),
+                                 corner_support, 2, corner_support.radii2));
+  }
+#endif
+}
+
+TEST_CASE("mls interpolation of several fields", "[interpolator]")
+{
+  Omega_h::Library lib;
+  const auto sources = lattice(3, 6, 0, 0.2);
+  const auto targets = lattice(3, 4, 0.1, 0.25);
+  const int nsources = sources.size() / 3;
+  const int ntargets = targets.size() / 3;
+  const auto support = brute_force_supports(3, sources, targets, 0.45);
+  const auto source_coordinates = to_reals(sources);
+  const auto target_coordinates = to_reals(targets);
+
+  constexpr int nfields = 3;
+  Kokkos::View<Omega_h::Real**> fields("fields", nsources, nfields);
+  auto fields_h = Kokkos::create_mirror_view(fields);
+  for (int i = 0; i < nsources; ++i) {
+    const auto x = sources[3 * i];
+    const auto y = sources[3 * i + 1];
+    const auto z = sources[3 * i + 2];
+    fields_h(i, 0) = std::sin(3 * x) * std::cos(2 * y) + z;
+    fields_h(i, 1) = x * y * z;
+    fields_h(i, 2) = std::exp(x - z) * y;
+  }
+  Kokkos::deep_copy(fields, fields_h);
+
+  const auto interpolated = Kokkos::create_mirror_view_and_copy(
+    Kokkos::HostSpace{},
+    mls_interpolation(Kokkos::View<const Omega_h::Real**>(fields),
+                      source_coordinates, target_coordinates, support, 3,
+                      support.radii2));
+  REQUIRE(interpolated.extent(0) == static_cast<std::size_t>(ntargets));
+  REQUIRE(interpolated.extent(1) == static_cast<std::size_t>(nfields));
+  // each column matches the interpolation of that field on its own
+  for (int f = 0; f < nfields; ++f) {
+    std::vector<Omega_h::Real> field(nsources);
+    for (int i = 0; i < nsources; ++i) {
+      field[i] = fields_h(i, f);
+    }
+    Omega_h::HostRead<Omega_h::Real> expected(
+      mls_interpolation(to_reals(field), source_coordinates,
+                        target_coordinates, support, 3, support.radii2));
+    for (int i = 0; i < ntargets; ++i) {
+      REQUIRE(interpolated(i, f) == Catch::Approx(expected[i]).margin(1E-12));
+    }
+  }
+}
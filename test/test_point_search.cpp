@@ -1,8 +1,12 @@
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/catch_approx.hpp>
 #include <pcms/point_search.h>
+#include <pcms/distributed_point_search.h>
 #include <Omega_h_mesh.hpp>
 #include <Omega_h_build.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
 using pcms::AABBox;
 using pcms::barycentric_from_global;
@@ -157,6 +161,34 @@ TEST_CASE("construct intersection map")
     REQUIRE(intersection_map.numRows() == 3600);
     REQUIRE(num_candidates_within_range(intersection_map, 1, 6));
   }
+  SECTION("matches exhaustive intersection test")
+  {
+    Kokkos::View<UniformGrid[1]> grid_d("uniform grid");
+    auto grid_h = Kokkos::create_mirror_view(grid_d);
+    grid_h(0) = UniformGrid{.edge_length{1, 1}, .bot_left = {0, 0}, .divisions = {13, 7}};
+    Kokkos::deep_copy(grid_d, grid_h);
+    auto intersection_map = pcms::detail::construct_intersection_map(mesh, grid_d, grid_h(0).GetNumCells());
+    auto row_map = Kokkos::create_mirror_view_and_copy(Kokkos::HostSpace{}, intersection_map.row_map);
+    auto entries = Kokkos::create_mirror_view_and_copy(Kokkos::HostSpace{}, intersection_map.entries);
+    auto tris2verts = Omega_h::HostRead<Omega_h::LO>(mesh.ask_elem_verts());
+    auto coords = Omega_h::HostRead<Omega_h::Real>(mesh.coords());
+    for (int cell = 0; cell < grid_h(0).GetNumCells(); ++cell) {
+      std::vector<pcms::LO> expected;
+      for (int elem = 0; elem < mesh.nelems(); ++elem) {
+        Omega_h::Matrix<2, 3> tri;
+        for (int v = 0; v < 3; ++v) {
+          tri[v] = {coords[2 * tris2verts[3 * elem + v]],
+                    coords[2 * tris2verts[3 * elem + v] + 1]};
+        }
+        if (pcms::triangle_intersects_bbox(tri, grid_h(0).GetCellBBOX(cell))) {
+          expected.push_back(elem);
+        }
+      }
+      std::vector<pcms::LO> found(entries.data() + row_map(cell),
+                                  entries.data() + row_map(cell + 1));
+      REQUIRE(found == expected);
+    }
+  }
 }
 TEST_CASE("uniform grid search") {
   using pcms::GridPointSearch;
@@ -199,13 +231,435 @@ TEST_CASE("uniform grid search") {
       REQUIRE(coords[2] == Catch::Approx(0.4));
     }
   }
-  // feature needs to be added
-  //SECTION("Global coordinate outisde mesh", "[!mayfail]") {
-  //  auto out_of_bounds = results_h(2);
-  //  auto top_left = results_h(3);
-  //  REQUIRE(-1*out_of_bounds.tri_id == top_left.tri_id);
-  //  out_of_bounds = results_h(4);
-  //  auto bot_left = results_h(0);
-  //  REQUIRE(-1*out_of_bounds.tri_id == bot_left.tri_id);
-  //}
+  SECTION("Global coordinate outisde mesh") {
+    auto out_of_bounds = results_h(2);
+    auto top_left = results_h(3);
+    REQUIRE(!out_of_bounds.Inside());
+    REQUIRE(top_left.Inside());
+    REQUIRE(out_of_bounds.ElementId() == top_left.tri_id);
+    // closest point is the corner of the mesh
+    auto [idx, coords] = results_h(3);
+    for (int i = 0; i < 3; ++i) {
+      REQUIRE(out_of_bounds.parametric_coords[i] == Catch::Approx(coords[i]).margin(1E-12));
+    }
+    out_of_bounds = results_h(4);
+    auto bot_left = results_h(0);
+    REQUIRE(!out_of_bounds.Inside());
+    REQUIRE(out_of_bounds.ElementId() == bot_left.tri_id);
+  }
+}
+
+TEST_CASE("automatic grid divisions")
+{
+  using pcms::detail::automatic_grid_divisions;
+  auto square = automatic_grid_divisions(1, 1, 200);
+  REQUIRE(square[0] == 14);
+  REQUIRE(square[1] == 15);
+  // cells stay close to square for elongated meshes
+  auto wide = automatic_grid_divisions(4, 1, 400);
+  REQUIRE(wide[0] == 40);
+  REQUIRE(wide[1] == 10);
+  auto empty = automatic_grid_divisions(1, 1, 0);
+  REQUIRE(empty[0] == 1);
+  REQUIRE(empty[1] == 1);
+  auto box = automatic_grid_divisions<3>({2, 1, 1}, 2000);
+  REQUIRE(box[0] == 20);
+  REQUIRE(box[1] == 10);
+  REQUIRE(box[2] == 10);
+  // flat directions are not divided
+  auto flat = automatic_grid_divisions<3>({1, 0, 1}, 100);
+  REQUIRE(flat[0] == 10);
+  REQUIRE(flat[1] == 1);
+  REQUIRE(flat[2] == 10);
+}
+
+TEST_CASE("adaptive point search")
+{
+  using pcms::GridPointSearch;
+  auto lib = Omega_h::Library{};
+  auto world = lib.world();
+  auto mesh =
+    Omega_h::build_box(world, OMEGA_H_SIMPLEX, 1, 1, 1, 10, 10, 0, false);
+  Kokkos::View<pcms::Real*[2]> points("test_points", 2);
+  auto points_h = Kokkos::create_mirror_view(points);
+  points_h(0,0) = 0;
+  points_h(0,1) = 0;
+  points_h(1,0) = 0.55;
+  points_h(1,1) = 0.54;
+  Kokkos::deep_copy(points, points_h);
+  auto check_results = [](const auto& results) {
+    auto results_h = Kokkos::create_mirror_view_and_copy(Kokkos::HostSpace{}, results);
+    {
+      auto [idx,coords] = results_h(0);
+      REQUIRE(idx == 0);
+      REQUIRE(coords[0] == Catch::Approx(1));
+    }
+    {
+      auto [idx,coords] = results_h(1);
+      REQUIRE(idx == 91);
+      REQUIRE(coords[0] == Catch::Approx(0.5));
+      REQUIRE(coords[1] == Catch::Approx(0.1));
+      REQUIRE(coords[2] == Catch::Approx(0.4));
+    }
+  };
+  SECTION("automatic grid size")
+  {
+    GridPointSearch search{mesh};
+    check_results(search(points));
+  }
+  SECTION("quadtree")
+  {
+    GridPointSearch search{mesh, pcms::QuadtreeOptions{.max_elements_per_leaf = 4}};
+    check_results(search(points));
+  }
+  SECTION("quadtree outside of mesh")
+  {
+    GridPointSearch search{mesh, pcms::QuadtreeOptions{.max_elements_per_leaf = 4}};
+    Kokkos::View<pcms::Real*[2]> outside("outside points", 1);
+    auto outside_h = Kokkos::create_mirror_view(outside);
+    outside_h(0, 0) = -1;
+    outside_h(0, 1) = -1;
+    Kokkos::deep_copy(outside, outside_h);
+    auto results_h = Kokkos::create_mirror_view_and_copy(Kokkos::HostSpace{}, search(outside));
+    REQUIRE(!results_h(0).Inside());
+    REQUIRE(results_h(0).ElementId() == 0);
+    REQUIRE(results_h(0).parametric_coords[0] == Catch::Approx(1));
+  }
+  SECTION("quadtree depth limit")
+  {
+    GridPointSearch search{mesh, pcms::QuadtreeOptions{.max_elements_per_leaf = 1, .max_depth = 3}};
+    check_results(search(points));
+  }
+}
+
+TEST_CASE("precomputed inverse bases")
+{
+  auto lib = Omega_h::Library{};
+  auto world = lib.world();
+  auto mesh =
+    Omega_h::build_box(world, OMEGA_H_SIMPLEX, 2, 1, 1, 4, 3, 0, false);
+  auto bases = pcms::detail::construct_inverse_bases(mesh.coords(),
+                                                     mesh.ask_elem_verts());
+  REQUIRE(bases.extent(0) == static_cast<size_t>(mesh.nelems()));
+  auto bases_h = Kokkos::create_mirror_view_and_copy(Kokkos::HostSpace{}, bases);
+  auto tris2verts = Omega_h::HostRead<Omega_h::LO>(mesh.ask_elem_verts());
+  auto coords = Omega_h::HostRead<Omega_h::Real>(mesh.coords());
+  const Omega_h::Vector<2> point{0.3, 0.7};
+  for (int elem = 0; elem < mesh.nelems(); ++elem) {
+    Omega_h::Matrix<2, 3> tri;
+    for (int v = 0; v < 3; ++v) {
+      tri[v] = {coords[2 * tris2verts[3 * elem + v]],
+                coords[2 * tris2verts[3 * elem + v] + 1]};
+    }
+    auto expected = barycentric_from_global(point, tri);
+    auto xi = pcms::detail::barycentric_from_bases(bases_h, elem, point);
+    for (int i = 0; i < 3; ++i) {
+      REQUIRE(xi[i] == Catch::Approx(expected[i]).margin(1E-12));
+    }
+  }
+}
+
+TEST_CASE("tetrahedron bbox intersection")
+{
+  using pcms::tetrahedron_intersects_bbox;
+  pcms::AABBox<3> unit_cube{.center = {0, 0, 0}, .half_width = {0.5, 0.5, 0.5}};
+  Omega_h::Matrix<3, 4> inside{{0, 0, 0}, {0.1, 0, 0}, {0, 0.1, 0}, {0, 0, 0.1}};
+  REQUIRE(tetrahedron_intersects_bbox(inside, unit_cube));
+  Omega_h::Matrix<3, 4> enclosing{
+    {-10, -10, -10}, {30, -10, -10}, {-10, 30, -10}, {-10, -10, 30}};
+  REQUIRE(tetrahedron_intersects_bbox(enclosing, unit_cube));
+  Omega_h::Matrix<3, 4> far{{2, 2, 2}, {3, 2, 2}, {2, 3, 2}, {2, 2, 3}};
+  REQUIRE(!tetrahedron_intersects_bbox(far, unit_cube));
+  // the bounding boxes overlap, but the slanted face separates the tet from
+  // the corner of the cube
+  Omega_h::Matrix<3, 4> cut{
+    {1.8, 0, 0}, {0, 1.8, 0}, {0, 0, 1.8}, {1.8, 1.8, 1.8}};
+  REQUIRE(!tetrahedron_intersects_bbox(cut, unit_cube));
+}
+
+TEST_CASE("3D point search")
+{
+  auto lib = Omega_h::Library{};
+  auto world = lib.world();
+  auto mesh =
+    Omega_h::build_box(world, OMEGA_H_SIMPLEX, 1, 1, 1, 4, 4, 4, false);
+  REQUIRE(mesh.dim() == 3);
+  auto tets2verts = Omega_h::HostRead<Omega_h::LO>(mesh.ask_elem_verts());
+  auto coords = Omega_h::HostRead<Omega_h::Real>(mesh.coords());
+  Kokkos::View<pcms::Real* [3]> points("test_points", 3);
+  auto points_h = Kokkos::create_mirror_view(points);
+  const Omega_h::Vector<3> expected[3] = {
+    {0.3, 0.55, 0.71}, {0.9, 0.1, 0.45}, {1, 0.5, 0.5}};
+  points_h(0, 0) = 0.3;
+  points_h(0, 1) = 0.55;
+  points_h(0, 2) = 0.71;
+  points_h(1, 0) = 0.9;
+  points_h(1, 1) = 0.1;
+  points_h(1, 2) = 0.45;
+  // outside of the mesh, closest to the x=1 face
+  points_h(2, 0) = 2;
+  points_h(2, 1) = 0.5;
+  points_h(2, 2) = 0.5;
+  Kokkos::deep_copy(points, points_h);
+  auto check_results = [&](const auto& results) {
+    auto results_h =
+      Kokkos::create_mirror_view_and_copy(Kokkos::HostSpace{}, results);
+    REQUIRE(results_h(0).Inside());
+    REQUIRE(results_h(1).Inside());
+    REQUIRE(!results_h(2).Inside());
+    for (int p = 0; p < 3; ++p) {
+      const auto elem = results_h(p).ElementId();
+      // the parametric coordinates map back to the (closest) point
+      Omega_h::Vector<3> point{0, 0, 0};
+      for (int v = 0; v < 4; ++v) {
+        const auto vert = tets2verts[4 * elem + v];
+        for (int d = 0; d < 3; ++d) {
+          point[d] += results_h(p).parametric_coords[v] * coords[3 * vert + d];
+        }
+      }
+      for (int d = 0; d < 3; ++d) {
+        REQUIRE(point[d] == Catch::Approx(expected[p][d]).margin(1E-12));
+      }
+    }
+  };
+  SECTION("uniform grid")
+  {
+    pcms::GridPointSearch3D search{mesh};
+    check_results(search(points));
+  }
+  SECTION("octree")
+  {
+    pcms::GridPointSearch3D search{
+      mesh, pcms::QuadtreeOptions{.max_elements_per_leaf = 8}};
+    check_results(search(points));
+  }
+}
+
+TEST_CASE("hinted point search")
+{
+  using pcms::GridPointSearch;
+  auto lib = Omega_h::Library{};
+  auto world = lib.world();
+  auto mesh =
+    Omega_h::build_box(world, OMEGA_H_SIMPLEX, 1, 1, 1, 10, 10, 0, false);
+  Kokkos::View<pcms::Real* [2]> points("test_points", 3);
+  auto points_h = Kokkos::create_mirror_view(points);
+  points_h(0, 0) = 0.12;
+  points_h(0, 1) = 0.31;
+  points_h(1, 0) = 0.55;
+  points_h(1, 1) = 0.54;
+  points_h(2, 0) = 0.93;
+  points_h(2, 1) = 0.07;
+  Kokkos::deep_copy(points, points_h);
+  auto check_hinted = [&](const GridPointSearch& search) {
+    auto hints = search(points);
+    // move the points by less than an element
+    for (int p = 0; p < 3; ++p) {
+      points_h(p, 0) += 0.03;
+      points_h(p, 1) += 0.02;
+    }
+    // the last point leaves the mesh, so the walk falls back to the grid
+    points_h(2, 0) = 1.5;
+    Kokkos::deep_copy(points, points_h);
+    auto expected_h = Kokkos::create_mirror_view_and_copy(
+      Kokkos::HostSpace{}, search(points));
+    auto results_h = Kokkos::create_mirror_view_and_copy(
+      Kokkos::HostSpace{}, search(points, hints));
+    for (int p = 0; p < 3; ++p) {
+      REQUIRE(results_h(p).tri_id == expected_h(p).tri_id);
+      for (int i = 0; i < 3; ++i) {
+        REQUIRE(results_h(p).parametric_coords[i] ==
+                Catch::Approx(expected_h(p).parametric_coords[i]).margin(1E-12));
+      }
+    }
+    // a hint far from the point still finds the point
+    Kokkos::View<GridPointSearch::Result*> far_hints("far hints", 3);
+    Kokkos::deep_copy(far_hints, GridPointSearch::Result{0, {1, 0, 0}});
+    results_h = Kokkos::create_mirror_view_and_copy(
+      Kokkos::HostSpace{}, search(points, far_hints));
+    for (int p = 0; p < 3; ++p) {
+      REQUIRE(results_h(p).tri_id == expected_h(p).tri_id);
+    }
+  };
+  SECTION("Omega_h mesh")
+  {
+    check_hinted(GridPointSearch{mesh});
+  }
+  SECTION("Omega_h mesh with a dual graph")
+  {
+    // the neighbors are matched with the existing dual graph
+    mesh.ask_dual();
+    check_hinted(GridPointSearch{mesh});
+  }
+  SECTION("element geometry")
+  {
+    check_hinted(GridPointSearch{mesh.coords(), mesh.ask_elem_verts()});
+  }
+}
+
+TEST_CASE("point search without elements")
+{
+  using pcms::GridPointSearch;
+  auto lib = Omega_h::Library{};
+  // the vertices give the search a bounding box, but no element can be found
+  const Omega_h::Reals coords({0, 0, 1, 0, 0, 1});
+  const Omega_h::LOs tris2verts(0, 0);
+  Kokkos::View<pcms::Real* [2]> points("test_points", 2);
+  auto points_h = Kokkos::create_mirror_view(points);
+  points_h(0, 0) = 0.25;
+  points_h(0, 1) = 0.25;
+  points_h(1, 0) = -1;
+  points_h(1, 1) = 2;
+  Kokkos::deep_copy(points, points_h);
+  auto check_not_found = [](Kokkos::View<GridPointSearch::Result*> results) {
+    auto results_h =
+      Kokkos::create_mirror_view_and_copy(Kokkos::HostSpace{}, results);
+    for (size_t p = 0; p < results_h.extent(0); ++p) {
+      REQUIRE(!results_h(p).Found());
+      REQUIRE(!results_h(p).Inside());
+      REQUIRE(results_h(p).ElementId() == -1);
+    }
+  };
+  SECTION("uniform grid")
+  {
+    GridPointSearch search{coords, tris2verts, 2, 2};
+    check_not_found(search(points));
+    // the walk cannot start from a hint without an element
+    check_not_found(search(points, search(points)));
+  }
+  SECTION("quadtree")
+  {
+    GridPointSearch search{coords, tris2verts, pcms::QuadtreeOptions{}};
+    check_not_found(search(points));
+  }
+}
+
+TEST_CASE("morton code")
+{
+  using pcms::detail::morton_code;
+  REQUIRE(morton_code<2>({0, 0}, 2) == 0);
+  REQUIRE(morton_code<2>({1, 0}, 2) == 1);
+  REQUIRE(morton_code<2>({0, 1}, 2) == 2);
+  REQUIRE(morton_code<2>({3, 3}, 2) == 15);
+  REQUIRE(morton_code<2>({2, 1}, 2) == 6);
+  REQUIRE(morton_code<3>({1, 1, 1}, 1) == 7);
+  REQUIRE(morton_code<3>({0, 0, 1}, 2) == 4);
+}
+
+TEST_CASE("spatially sorted point search")
+{
+  using pcms::GridPointSearch;
+  auto lib = Omega_h::Library{};
+  auto world = lib.world();
+  auto mesh =
+    Omega_h::build_box(world, OMEGA_H_SIMPLEX, 1, 1, 1, 10, 10, 0, false);
+  constexpr int npoints = 200;
+  Kokkos::View<pcms::Real* [2]> points("test_points", npoints);
+  auto points_h = Kokkos::create_mirror_view(points);
+  // scattered points, some of which are outside of the mesh
+  for (int p = 0; p < npoints; ++p) {
+    points_h(p, 0) = std::fmod(0.618034 * p, 1.2) - 0.1;
+    points_h(p, 1) = std::fmod(0.414214 * p, 1.2) - 0.1;
+  }
+  Kokkos::deep_copy(points, points_h);
+  auto check = [&](const GridPointSearch& search) {
+    auto expected_h = Kokkos::create_mirror_view_and_copy(
+      Kokkos::HostSpace{}, search(points));
+    auto results_h = Kokkos::create_mirror_view_and_copy(
+      Kokkos::HostSpace{}, search(points, pcms::QueryOrder::Spatial));
+    for (int p = 0; p < npoints; ++p) {
+      REQUIRE(results_h(p).tri_id == expected_h(p).tri_id);
+      for (int i = 0; i < 3; ++i) {
+        REQUIRE(results_h(p).parametric_coords[i] ==
+                expected_h(p).parametric_coords[i]);
+      }
+    }
+  };
+  SECTION("uniform grid") { check(GridPointSearch{mesh}); }
+  SECTION("quadtree")
+  {
+    check(GridPointSearch{mesh, pcms::QuadtreeOptions{}});
+  }
+}
+
+TEST_CASE("distributed point search")
+{
+  auto lib = Omega_h::Library{};
+  auto world = lib.world();
+  auto mesh =
+    Omega_h::build_box(world, OMEGA_H_SIMPLEX, 1, 1, 1, 10, 10, 0, false);
+  pcms::DistributedPointSearch search{mesh, MPI_COMM_WORLD};
+  int nranks = 0;
+  MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+  const auto& bounds = search.GetPartitionBounds();
+  REQUIRE(bounds.size() == static_cast<std::size_t>(nranks));
+  // linear fields are reproduced exactly by linear interpolation
+  const auto coords = Omega_h::HostRead<pcms::Real>(mesh.coords());
+  Omega_h::HostWrite<pcms::Real> nodal_values_h(2 * mesh.nverts());
+  for (int v = 0; v < mesh.nverts(); ++v) {
+    nodal_values_h[2 * v] = 2 * coords[2 * v] + coords[2 * v + 1];
+    nodal_values_h[2 * v + 1] = coords[2 * v] - 3 * coords[2 * v + 1];
+  }
+  constexpr int npoints = 100;
+  Kokkos::View<pcms::Real* [2]> points("test_points", npoints);
+  auto points_h = Kokkos::create_mirror_view(points);
+  for (int p = 0; p < npoints; ++p) {
+    points_h(p, 0) = std::fmod(0.618034 * p, 1.0);
+    points_h(p, 1) = std::fmod(0.414214 * p, 1.0);
+  }
+  Kokkos::deep_copy(points, points_h);
+  const auto values = Omega_h::HostRead<pcms::Real>(search.Evaluate(
+    points, Omega_h::Reals(nodal_values_h.write()), 2));
+  REQUIRE(values.size() == 2 * npoints);
+  for (int p = 0; p < npoints; ++p) {
+    const auto x = points_h(p, 0);
+    const auto y = points_h(p, 1);
+    REQUIRE(values[2 * p] == Catch::Approx(2 * x + y));
+    REQUIRE(values[2 * p + 1] == Catch::Approx(x - 3 * y).margin(1E-12));
+  }
+}
+
+TEST_CASE("distributed point search across ranks", "[mpi]")
+{
+  auto lib = Omega_h::Library{};
+  int rank = -1;
+  int nranks = 0;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+  // each rank holds the unit square shifted by its rank in x, so the global
+  // mesh is [0, nranks] x [0, 1]
+  auto mesh =
+    Omega_h::build_box(lib.self(), OMEGA_H_SIMPLEX, 1, 1, 1, 4, 4, 0, false);
+  const auto coords = Omega_h::HostRead<pcms::Real>(mesh.coords());
+  Omega_h::HostWrite<pcms::Real> shifted(coords.size());
+  Omega_h::HostWrite<pcms::Real> nodal_values_h(mesh.nverts());
+  for (int v = 0; v < mesh.nverts(); ++v) {
+    shifted[2 * v] = coords[2 * v] + rank;
+    shifted[2 * v + 1] = coords[2 * v + 1];
+    nodal_values_h[v] = shifted[2 * v] + 2 * shifted[2 * v + 1];
+  }
+  mesh.set_coords(Omega_h::Reals(shifted.write()));
+  pcms::DistributedPointSearch search{mesh, MPI_COMM_WORLD};
+  // every rank evaluates points in all partitions and outside of the mesh
+  constexpr int ny = 5;
+  const int nx = 2 * (nranks + 2);
+  Kokkos::View<pcms::Real* [2]> points("test_points", nx * ny);
+  auto points_h = Kokkos::create_mirror_view(points);
+  for (int i = 0; i < nx; ++i) {
+    for (int j = 0; j < ny; ++j) {
+      points_h(i * ny + j, 0) = -0.75 + (nranks + 1.5) * i / (nx - 1);
+      points_h(i * ny + j, 1) = -0.5 + 2.0 * j / (ny - 1);
+    }
+  }
+  Kokkos::deep_copy(points, points_h);
+  const auto values = Omega_h::HostRead<pcms::Real>(
+    search.Evaluate(points, Omega_h::Reals(nodal_values_h.write())));
+  REQUIRE(values.size() == nx * ny);
+  for (int p = 0; p < nx * ny; ++p) {
+    // points outside of the mesh take the value at the closest point of the
+    // global mesh, not of the local partition
+    const auto x = std::clamp<pcms::Real>(points_h(p, 0), 0, nranks);
+    const auto y = std::clamp<pcms::Real>(points_h(p, 1), 0, 1);
+    REQUIRE(values[p] == Catch::Approx(x + 2 * y).margin(1E-12));
+  }
 }
@@ -40,6 +40,9 @@ void xgc_coupler(MPI_Comm comm, Omega_h::Mesh& mesh, std::string_view cpn_file)
     rc = ConstructRCFromOmegaHMesh<GO>(mesh, "global", pcms::IndexBase::Zero);
   }
 
+  // convert once so that the fields on every plane share the same storage
+  const pcms::ReverseClassificationVertexCSR<> rc_csr{rc};
+
   auto is_overlap =
     ts::markServerOverlapRegion(mesh, partition, ts::IsModelEntInOverlap{});
   auto* application = cpl.AddApplication("proxy_couple");
@@ -52,7 +55,8 @@ void xgc_coupler(MPI_Comm comm, Omega_h::Mesh& mesh, std::string_view cpn_file)
     std::stringstream ss;
     ss << "xgc_gids_plane_" << i;
     auto field_adapter = pcms::XGCFieldAdapter<GO>(
-      ss.str(), comm, make_array_view(data[i]), rc, ts::IsModelEntInOverlap{});
+      ss.str(), comm, make_array_view(data[i]), rc_csr,
+      ts::IsModelEntInOverlap{});
     fields.push_back(
       application->AddField(ss.str(), std::move(field_adapter),
                             FieldTransferMethod::Copy, // to Omega_h
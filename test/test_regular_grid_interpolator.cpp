@@ -0,0 +1,213 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include <linear_interpolant.hpp>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <vector>
+
+template <int dim>
+using Field = std::function<double(const std::array<double, dim>&)>;
+
+// values of the fields at the nodes of the grid, numbered as
+// RegularGridInterpolator numbers them
+template <int dim>
+static RealMatView node_values(const std::array<int, dim>& num_bins,
+                               const std::array<double, dim>& lower,
+                               const std::array<double, dim>& upper,
+                               const std::vector<Field<dim>>& fields)
+{
+  int nnodes = 1;
+  for (int d = 0; d < dim; ++d) {
+    nnodes *= num_bins[d] + 1;
+  }
+  RealMatView values("node values", nnodes, fields.size());
+  auto values_h = Kokkos::create_mirror_view(values);
+  for (int node = 0; node < nnodes; ++node) {
+    std::array<double, dim> x;
+    int remainder = node;
+    for (int d = dim - 1; d >= 0; --d) {
+      const int i = remainder % (num_bins[d] + 1);
+      remainder /= num_bins[d] + 1;
+      x[d] = lower[d] + i * (upper[d] - lower[d]) / num_bins[d];
+    }
+    for (std::size_t f = 0; f < fields.size(); ++f) {
+      values_h(node, f) = fields[f](x);
+    }
+  }
+  Kokkos::deep_copy(values, values_h);
+  return values;
+}
+
+// random points in the grid together with the corners of the grid and points
+// in the first and last cell of every direction
+template <int dim>
+static std::vector<std::array<double, dim>> sample_points(
+  const std::array<int, dim>& num_bins, const std::array<double, dim>& lower,
+  const std::array<double, dim>& upper)
+{
+  std::mt19937 generator(7);
+  std::vector<std::array<double, dim>> points;
+  for (int p = 0; p < 100; ++p) {
+    std::array<double, dim> point;
+    for (int d = 0; d < dim; ++d) {
+      point[d] = std::uniform_real_distribution<double>(lower[d],
+                                                        upper[d])(generator);
+    }
+    points.push_back(point);
+  }
+  for (int corner = 0; corner < (1 << dim); ++corner) {
+    std::array<double, dim> point;
+    for (int d = 0; d < dim; ++d) {
+      point[d] = (corner & (1 << d)) ? upper[d] : lower[d];
+    }
+    points.push_back(point);
+  }
+  for (int d = 0; d < dim; ++d) {
+    const double cell_width = (upper[d] - lower[d]) / num_bins[d];
+    for (double offset : {0.1, 0.5, 0.9}) {
+      auto first = points[d];
+      first[d] = lower[d] + offset * cell_width;
+      points.push_back(first);
+      auto last = points[d];
+      last[d] = upper[d] - offset * cell_width;
+      points.push_back(last);
+    }
+  }
+  return points;
+}
+
+template <int dim>
+static RealMatView to_view(const std::vector<std::array<double, dim>>& points)
+{
+  RealMatView view("points", points.size(), dim);
+  auto view_h = Kokkos::create_mirror_view(view);
+  for (std::size_t p = 0; p < points.size(); ++p) {
+    for (int d = 0; d < dim; ++d) {
+      view_h(p, d) = points[p][d];
+    }
+  }
+  Kokkos::deep_copy(view, view_h);
+  return view;
+}
+
+// checks that the interpolation of the fields matches the fields at the
+// sample points
+template <int dim, InterpolationOrder order>
+static void check_reproduction(const std::array<int, dim>& num_bins,
+                               const std::array<double, dim>& lower,
+                               const std::array<double, dim>& upper,
+                               const std::vector<Field<dim>>& fields)
+{
+  const RegularGridInterpolator<dim, order> interpolator(num_bins, lower,
+                                                         upper);
+  const auto points = sample_points<dim>(num_bins, lower, upper);
+  const auto values = node_values<dim>(num_bins, lower, upper, fields);
+  REQUIRE(static_cast<int>(values.extent(0)) == interpolator.num_nodes());
+  const auto interpolated = Kokkos::create_mirror_view_and_copy(
+    Kokkos::HostSpace{}, interpolator.evaluate(to_view<dim>(points), values));
+  for (std::size_t p = 0; p < points.size(); ++p) {
+    for (std::size_t f = 0; f < fields.size(); ++f) {
+      REQUIRE(interpolated(p, f) ==
+              Catch::Approx(fields[f](points[p])).margin(1E-12));
+    }
+  }
+}
+
+TEST_CASE("regular grid interpolation", "[interpolator]")
+{
+  SECTION("linear order reproduces multilinear fields")
+  {
+    check_reproduction<2, InterpolationOrder::Linear>(
+      {4, 5}, {0, -1}, {2, 1.5},
+      {[](const std::array<double, 2>& x) {
+         return 1 + 2 * x[0] - x[1] + 3 * x[0] * x[1];
+       },
+       [](const std::array<double, 2>& x) { return 0.5 - x[0] * x[1]; }});
+    check_reproduction<3, InterpolationOrder::Linear>(
+      {3, 4, 2}, {0, 0, -1}, {1, 2, 1},
+      {[](const std::array<double, 3>& x) {
+        return 1 + x[0] + 2 * x[1] - x[2] + x[0] * x[1] - x[1] * x[2] +
+               0.5 * x[0] * x[1] * x[2];
+      }});
+  }
+  SECTION("cubic order reproduces linear fields")
+  {
+    check_reproduction<2, InterpolationOrder::Cubic>(
+      {3, 6}, {0, -1}, {2, 1.5},
+      {[](const std::array<double, 2>& x) { return 0.5 + 2 * x[0] - 3 * x[1]; },
+       [](const std::array<double, 2>& x) { return -x[0] + x[1]; }});
+    check_reproduction<3, InterpolationOrder::Cubic>(
+      {3, 4, 5}, {0, 0, -1}, {1, 2, 1},
+      {[](const std::array<double, 3>& x) {
+        return 1 + x[0] - 2 * x[1] + 0.5 * x[2];
+      }});
+  }
+  SECTION("single and multiple field evaluation agree")
+  {
+    const std::array<int, 2> num_bins{5, 4};
+    const std::array<double, 2> lower{0, 0};
+    const std::array<double, 2> upper{1, 1};
+    const RegularGridInterpolator<2, InterpolationOrder::Cubic> interpolator(
+      num_bins, lower, upper);
+    const auto points = to_view<2>(sample_points<2>(num_bins, lower, upper));
+    const auto values = node_values<2>(
+      num_bins, lower, upper,
+      {[](const std::array<double, 2>& x) { return std::sin(3 * x[0]) * x[1]; },
+       [](const std::array<double, 2>& x) { return std::exp(x[0] - x[1]); }});
+    const auto interpolated = Kokkos::create_mirror_view_and_copy(
+      Kokkos::HostSpace{}, interpolator.evaluate(points, values));
+    for (int f = 0; f < 2; ++f) {
+      RealVecView field("field", values.extent(0));
+      Kokkos::deep_copy(field, Kokkos::subview(values, Kokkos::ALL(), f));
+      const auto interpolated_field = Kokkos::create_mirror_view_and_copy(
+        Kokkos::HostSpace{}, interpolator.evaluate(points, field));
+      REQUIRE(interpolated_field.extent(0) == points.extent(0));
+      for (std::size_t p = 0; p < points.extent(0); ++p) {
+        REQUIRE(interpolated_field(p) ==
+                Catch::Approx(interpolated(p, f)).margin(1E-14));
+      }
+    }
+  }
+  SECTION("parametric indices and linear interpolation")
+  {
+    const std::array<int, 2> num_bins{4, 3};
+    const std::array<double, 2> lower{-1, 0};
+    const std::array<double, 2> upper{1, 3};
+    const auto points = to_view<2>(sample_points<2>(num_bins, lower, upper));
+    const auto values = node_values<2>(
+      num_bins, lower, upper,
+      {[](const std::array<double, 2>& x) { return std::sin(x[0]) + x[1]; }});
+    const RegularGridInterpolator<2> interpolator(num_bins, lower, upper);
+    const auto expected = Kokkos::create_mirror_view_and_copy(
+      Kokkos::HostSpace{}, interpolator.evaluate(points, values));
+
+    IntVecView bins("bins", 2);
+    IntVecView dimensions("dimensions", 2);
+    RealVecView range("range", 4);
+    auto bins_h = Kokkos::create_mirror_view(bins);
+    auto dimensions_h = Kokkos::create_mirror_view(dimensions);
+    auto range_h = Kokkos::create_mirror_view(range);
+    for (int d = 0; d < 2; ++d) {
+      bins_h(d) = num_bins[d];
+      dimensions_h(d) = num_bins[d] + 1;
+      range_h(2 * d) = lower[d];
+      range_h(2 * d + 1) = upper[d];
+    }
+    Kokkos::deep_copy(bins, bins_h);
+    Kokkos::deep_copy(dimensions, dimensions_h);
+    Kokkos::deep_copy(range, range_h);
+    RealVecView field("field", values.extent(0));
+    Kokkos::deep_copy(field, Kokkos::subview(values, Kokkos::ALL(), 0));
+
+    const auto result = parametric_indices(points, bins, range);
+    const auto interpolated = Kokkos::create_mirror_view_and_copy(
+      Kokkos::HostSpace{},
+      linear_interpolation(result.parametric_coords, field, result.indices_pts,
+                           dimensions));
+    for (std::size_t p = 0; p < points.extent(0); ++p) {
+      REQUIRE(interpolated(p) == Catch::Approx(expected(p, 0)).margin(1E-12));
+    }
+  }
+}
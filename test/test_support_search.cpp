@@ -0,0 +1,329 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include <Omega_h_build.hpp>
+#include <Omega_h_library.hpp>
+#include <Omega_h_mesh.hpp>
+#include <adj_search_dega2.hpp>
+#include <knn_search.hpp>
+#include <MLSCoefficients.hpp>
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <random>
+#include <set>
+#include <vector>
+
+// support search over the cells whose centroids are within the cutoff of a
+// vertex with a breadth first search that has an unbounded queue and visited
+// set
+class ReferenceSearch
+{
+public:
+  explicit ReferenceSearch(Omega_h::Mesh& mesh)
+    : coords_(mesh.coords()),
+      faces2verts_(mesh.ask_down(Omega_h::FACE, Omega_h::VERT).ab2b),
+      v2f_ptr_(mesh.ask_up(Omega_h::VERT, Omega_h::FACE).a2ab),
+      v2f_(mesh.ask_up(Omega_h::VERT, Omega_h::FACE).ab2b)
+  {
+  }
+  // sorted supports of the vertex
+  std::vector<Omega_h::LO> operator()(Omega_h::LO vert,
+                                      Omega_h::Real cutoff2) const
+  {
+    std::vector<Omega_h::LO> supports;
+    std::set<Omega_h::LO> visited;
+    std::deque<Omega_h::LO> queue;
+    const auto visit = [&](Omega_h::LO face) {
+      if (!visited.insert(face).second) {
+        return;
+      }
+      Omega_h::Real dist2 = 0;
+      for (int k = 0; k < 2; ++k) {
+        Omega_h::Real centroid = 0;
+        for (int j = 0; j < 3; ++j) {
+          centroid += coords_[faces2verts_[face * 3 + j] * 2 + k];
+        }
+        const auto dx = centroid / 3 - coords_[vert * 2 + k];
+        dist2 += dx * dx;
+      }
+      if (dist2 <= cutoff2) {
+        supports.push_back(face);
+        queue.push_back(face);
+      }
+    };
+    for (auto i = v2f_ptr_[vert]; i < v2f_ptr_[vert + 1]; ++i) {
+      visit(v2f_[i]);
+    }
+    while (!queue.empty()) {
+      const auto face = queue.front();
+      queue.pop_front();
+      for (int j = 0; j < 3; ++j) {
+        const auto other = faces2verts_[face * 3 + j];
+        for (auto i = v2f_ptr_[other]; i < v2f_ptr_[other + 1]; ++i) {
+          visit(v2f_[i]);
+        }
+      }
+    }
+    std::sort(supports.begin(), supports.end());
+    return supports;
+  }
+
+private:
+  Omega_h::HostRead<Omega_h::Real> coords_;
+  Omega_h::HostRead<Omega_h::LO> faces2verts_;
+  Omega_h::HostRead<Omega_h::LO> v2f_ptr_;
+  Omega_h::HostRead<Omega_h::LO> v2f_;
+};
+
+// sorted supports of one target of the CSR
+static std::vector<Omega_h::LO> csr_row(
+  const Omega_h::HostRead<Omega_h::LO>& ptr,
+  const Omega_h::HostRead<Omega_h::LO>& idx, Omega_h::LO row)
+{
+  std::vector<Omega_h::LO> supports(idx.data() + ptr[row],
+                                    idx.data() + ptr[row + 1]);
+  std::sort(supports.begin(), supports.end());
+  return supports;
+}
+
+// supports of every vertex within the cutoff from the adjacency search
+static SupportResults adjacency_supports(Omega_h::Mesh& mesh,
+                                         Omega_h::Real cutoff2)
+{
+  const auto nverts = mesh.nverts();
+  FindSupports search(mesh);
+  SupportResults support;
+  Omega_h::Write<Omega_h::LO> nsupports(nverts, 0);
+  Omega_h::Write<Omega_h::Real> radii2(nverts, cutoff2);
+  search.adjBasedSearch(support.supports_ptr, nsupports, support.supports_idx,
+                        radii2, true);
+
+  const Omega_h::HostRead<Omega_h::LO> nsupports_h(nsupports);
+  Omega_h::HostWrite<Omega_h::LO> supports_ptr_h(nverts + 1);
+  supports_ptr_h[0] = 0;
+  for (Omega_h::LO v = 0; v < nverts; ++v) {
+    supports_ptr_h[v + 1] = supports_ptr_h[v] + nsupports_h[v];
+  }
+  support.supports_ptr = supports_ptr_h.write();
+  support.supports_idx = Omega_h::Write<Omega_h::LO>(
+    Omega_h::HostRead<Omega_h::LO>(support.supports_ptr)[nverts], 0);
+  search.adjBasedSearch(support.supports_ptr, nsupports, support.supports_idx,
+                        radii2, false);
+  return support;
+}
+
+TEST_CASE("adjacency support search", "[interpolator]")
+{
+  Omega_h::Library lib;
+  const auto check_reference = [](Omega_h::Mesh& mesh, Omega_h::Real cutoff2) {
+    const auto support = adjacency_supports(mesh, cutoff2);
+    const ReferenceSearch reference(mesh);
+    const Omega_h::HostRead<Omega_h::LO> ptr(support.supports_ptr);
+    const Omega_h::HostRead<Omega_h::LO> idx(support.supports_idx);
+    for (Omega_h::LO v = 0; v < mesh.nverts(); ++v) {
+      const auto found = csr_row(ptr, idx, v);
+      REQUIRE(!found.empty());
+      REQUIRE(found == reference(v, cutoff2));
+    }
+  };
+  SECTION("small cutoff matches an unbounded search")
+  {
+    auto mesh = Omega_h::build_box(lib.world(), OMEGA_H_SIMPLEX, 1, 1, 0, 10,
+                                   10, 0, false);
+    check_reference(mesh, 0.15 * 0.15);
+  }
+  SECTION("cutoff that visits every one of 800 cells")
+  {
+    // the original visited list held 800 cells, so this search has to fit
+    auto mesh = Omega_h::build_box(lib.world(), OMEGA_H_SIMPLEX, 1, 1, 0, 20,
+                                   20, 0, false);
+    REQUIRE(mesh.nfaces() == 800);
+    check_reference(mesh, 10.0);
+  }
+  SECTION("cutoff that visits too many cells keeps the supports found")
+  {
+    auto mesh = Omega_h::build_box(lib.world(), OMEGA_H_SIMPLEX, 1, 1, 0, 40,
+                                   40, 0, false);
+    REQUIRE(mesh.nfaces() > MAX_SIZE_TRACK);
+    // the search stops at the size of the visited set and warns rather than
+    // failing
+    const auto support = adjacency_supports(mesh, 10.0);
+    const Omega_h::HostRead<Omega_h::LO> ptr(support.supports_ptr);
+    for (Omega_h::LO v = 0; v < mesh.nverts(); ++v) {
+      const auto nsupports = ptr[v + 1] - ptr[v];
+      REQUIRE(nsupports > 0);
+      REQUIRE(nsupports <= MAX_SIZE_TRACK);
+    }
+  }
+}
+
+TEST_CASE("support search with radius adaptation", "[interpolator]")
+{
+  Omega_h::Library lib;
+  auto mesh =
+    Omega_h::build_box(lib.world(), OMEGA_H_SIMPLEX, 1, 1, 0, 10, 10, 0, false);
+  const auto nverts = mesh.nverts();
+  // small enough that every target needs its radius grown at least once
+  const Omega_h::Real cutoff2 = 0.05 * 0.05;
+  const auto support = searchNeighbors(mesh, cutoff2);
+
+  const Omega_h::HostRead<Omega_h::LO> ptr(support.supports_ptr);
+  const Omega_h::HostRead<Omega_h::LO> idx(support.supports_idx);
+  const Omega_h::HostRead<Omega_h::Real> radii2(support.radii2);
+  REQUIRE(ptr.size() == nverts + 1);
+  REQUIRE(ptr[0] == 0);
+  REQUIRE(idx.size() == ptr[nverts]);
+  // the previous implementation grew the radii of every target with fewer
+  // than 12 supports and searched all of the targets again until none was
+  // left. The targets are independent, so the same radii and supports follow
+  // from growing each target on its own
+  const ReferenceSearch reference(mesh);
+  for (Omega_h::LO v = 0; v < nverts; ++v) {
+    Omega_h::Real expected_radius2 = cutoff2;
+    auto expected = reference(v, expected_radius2);
+    while (expected.size() < 12) {
+      const auto nsupports = static_cast<Omega_h::Real>(expected.size());
+      Omega_h::Real factor = 12 / nsupports;
+      factor = (expected.empty() || factor > 3.0) ? 3.0 : factor;
+      expected_radius2 *= factor;
+      expected = reference(v, expected_radius2);
+    }
+    REQUIRE(radii2[v] == expected_radius2);
+    REQUIRE(ptr[v + 1] - ptr[v] == static_cast<Omega_h::LO>(expected.size()));
+    REQUIRE(csr_row(ptr, idx, v) == expected);
+  }
+}
+
+static Omega_h::Reals to_reals(const std::vector<Omega_h::Real>& values)
+{
+  Omega_h::HostWrite<Omega_h::Real> values_h(values.size());
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    values_h[i] = values[i];
+  }
+  return Omega_h::Reals(values_h.write());
+}
+
+static std::vector<Omega_h::Real> random_points(int dim, int npoints,
+                                                Omega_h::Real low,
+                                                Omega_h::Real high,
+                                                std::mt19937& generator)
+{
+  std::uniform_real_distribution<Omega_h::Real> distribution(low, high);
+  std::vector<Omega_h::Real> points(npoints * dim);
+  for (auto& coordinate : points) {
+    coordinate = distribution(generator);
+  }
+  return points;
+}
+
+// compares the k nearest neighbors of every target with a brute force search.
+// Supports tied at the k-th distance may be any of the tied sources, so the
+// distances of the supports are compared rather than their indices
+template <int dim>
+static void check_knn(const std::vector<Omega_h::Real>& sources,
+                      const std::vector<Omega_h::Real>& targets, Omega_h::LO k)
+{
+  const Omega_h::LO nsources = sources.size() / dim;
+  const Omega_h::LO ntargets = targets.size() / dim;
+  const auto nsupports = std::min(k, nsources);
+  const auto support =
+    searchKNearestNeighbors<dim>(to_reals(sources), to_reals(targets), k);
+  const Omega_h::HostRead<Omega_h::LO> ptr(support.supports_ptr);
+  const Omega_h::HostRead<Omega_h::LO> idx(support.supports_idx);
+  const Omega_h::HostRead<Omega_h::Real> radii2(support.radii2);
+  REQUIRE(ptr.size() == ntargets + 1);
+  REQUIRE(radii2.size() == ntargets);
+  const auto distance2 = [&](Omega_h::LO source, Omega_h::LO target) {
+    Omega_h::Real dist2 = 0;
+    for (int d = 0; d < dim; ++d) {
+      const auto dx = sources[source * dim + d] - targets[target * dim + d];
+      dist2 += dx * dx;
+    }
+    return dist2;
+  };
+  for (Omega_h::LO t = 0; t < ntargets; ++t) {
+    REQUIRE(ptr[t + 1] - ptr[t] == nsupports);
+    std::vector<Omega_h::Real> expected(nsources);
+    for (Omega_h::LO s = 0; s < nsources; ++s) {
+      expected[s] = distance2(s, t);
+    }
+    std::sort(expected.begin(), expected.end());
+    std::set<Omega_h::LO> unique_supports;
+    std::vector<Omega_h::Real> found;
+    for (auto j = ptr[t]; j < ptr[t + 1]; ++j) {
+      unique_supports.insert(idx[j]);
+      found.push_back(distance2(idx[j], t));
+    }
+    REQUIRE(static_cast<Omega_h::LO>(unique_supports.size()) == nsupports);
+    std::sort(found.begin(), found.end());
+    for (Omega_h::LO j = 0; j < nsupports; ++j) {
+      REQUIRE(found[j] == Catch::Approx(expected[j]).margin(1E-12));
+    }
+    // every support, including the k-th, has a nonzero weight
+    REQUIRE(std::isfinite(radii2[t]));
+    REQUIRE(radii2[t] > found.back());
+    REQUIRE(rbf(found.back(), radii2[t]) > 0);
+  }
+}
+
+TEST_CASE("k nearest neighbor supports", "[interpolator]")
+{
+  Omega_h::Library lib;
+  std::mt19937 generator(42);
+  SECTION("random points with targets outside of the sources")
+  {
+    const auto sources_2d = random_points(2, 300, 0, 1, generator);
+    const auto targets_2d = random_points(2, 200, -0.5, 1.5, generator);
+    check_knn<2>(sources_2d, targets_2d, 1);
+    check_knn<2>(sources_2d, targets_2d, 12);
+    check_knn<2>(sources_2d, targets_2d, max_knn);
+    const auto sources_3d = random_points(3, 500, 0, 1, generator);
+    const auto targets_3d = random_points(3, 200, -0.5, 1.5, generator);
+    check_knn<3>(sources_3d, targets_3d, 1);
+    check_knn<3>(sources_3d, targets_3d, 20);
+    check_knn<3>(sources_3d, targets_3d, max_knn);
+  }
+  SECTION("fewer sources than neighbors")
+  {
+    const auto sources = random_points(2, 5, 0, 1, generator);
+    const auto targets = random_points(2, 20, -1, 2, generator);
+    check_knn<2>(sources, targets, 12);
+  }
+  SECTION("sources on a line and on a plane")
+  {
+    // the grid is not divided in the directions of zero length
+    auto sources_2d = random_points(2, 100, 0, 1, generator);
+    for (std::size_t i = 1; i < sources_2d.size(); i += 2) {
+      sources_2d[i] = 0.5;
+    }
+    const auto targets_2d = random_points(2, 50, -0.5, 1.5, generator);
+    check_knn<2>(sources_2d, targets_2d, 6);
+    auto sources_3d = random_points(3, 200, 0, 1, generator);
+    for (std::size_t i = 2; i < sources_3d.size(); i += 3) {
+      sources_3d[i] = 0.25;
+    }
+    const auto targets_3d = random_points(3, 50, -0.5, 1.5, generator);
+    check_knn<3>(sources_3d, targets_3d, 10);
+  }
+  SECTION("coincident sources and targets")
+  {
+    const std::vector<Omega_h::Real> sources(2 * 10, 0.5);
+    const std::vector<Omega_h::Real> targets{0.5, 0.5, 1, 0.5, -1, -1};
+    check_knn<2>(sources, targets, 4);
+  }
+  SECTION("ties at the k-th distance")
+  {
+    std::vector<Omega_h::Real> sources;
+    for (int i = 0; i < 6; ++i) {
+      for (int j = 0; j < 6; ++j) {
+        sources.push_back(i);
+        sources.push_back(j);
+      }
+    }
+    // the 4 closest sources of a cell center are tied, and so are the 8
+    // after them
+    const std::vector<Omega_h::Real> targets{2.5, 2.5, 0.5, 4.5, 3, 3};
+    check_knn<2>(sources, targets, 4);
+    check_knn<2>(sources, targets, 6);
+  }
+}
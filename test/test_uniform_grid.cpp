@@ -48,3 +48,35 @@ TEST_CASE("uniform grid")
     REQUIRE(119 == uniform_grid.GetCellIndex(11,9));
   }
 }
+
+TEST_CASE("3D uniform grid")
+{
+  pcms::UniformGrid3D uniform_grid{
+    .edge_length = {10, 12, 6}, .bot_left = {0, 0, 0}, .divisions = {10, 12, 3}};
+  REQUIRE(uniform_grid.GetNumCells() == 360);
+  SECTION("Closest Cell ID")
+  {
+    REQUIRE(0 == uniform_grid.ClosestCellID(Omega_h::Vector<3>{0, 0, 0}));
+    REQUIRE(1 == uniform_grid.ClosestCellID(Omega_h::Vector<3>{1.5, 0, 0}));
+    REQUIRE(10 == uniform_grid.ClosestCellID(Omega_h::Vector<3>{0, 1.5, 0}));
+    REQUIRE(120 == uniform_grid.ClosestCellID(Omega_h::Vector<3>{0, 0, 2.5}));
+    REQUIRE(359 == uniform_grid.ClosestCellID(Omega_h::Vector<3>{100, 100, 100}));
+  }
+  SECTION("cell bbox")
+  {
+    auto bbox = uniform_grid.GetCellBBOX(359);
+    REQUIRE(bbox.center[0] == Catch::Approx(9.5));
+    REQUIRE(bbox.center[1] == Catch::Approx(11.5));
+    REQUIRE(bbox.center[2] == Catch::Approx(5));
+    REQUIRE(bbox.half_width[2] == Catch::Approx(1));
+  }
+  SECTION("dimensioned index")
+  {
+    // indexes are in (z,y,x) order
+    auto index = uniform_grid.GetDimensionedIndex(121);
+    REQUIRE(index[0] == 1);
+    REQUIRE(index[1] == 0);
+    REQUIRE(index[2] == 1);
+    REQUIRE(121 == uniform_grid.GetCellIndex(index));
+  }
+}
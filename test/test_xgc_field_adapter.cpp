@@ -2,11 +2,14 @@
 #include <catch2/catch_template_test_macros.hpp>
 #include <pcms/xgc_field_adapter.h>
 #include <algorithm>
+#include <cmath>
+#include <memory>
 
 using pcms::DimID;
 using pcms::make_array_view;
 using pcms::make_const_array_view;
 using pcms::ReverseClassificationVertex;
+using pcms::ReverseClassificationVertexCSR;
 using pcms::XGCFieldAdapter;
 
 ReverseClassificationVertex create_dummy_rc(int size)
@@ -90,8 +93,9 @@ TEMPLATE_TEST_CASE("XGC Field Adapter", "[adapter]", pcms::LO, pcms::Real)
   std::cout << "Num in overlap: " << num_in_overlap << "\n";
 
   std::cerr<<"creating addapter\n";
-  XGCFieldAdapter<TestType> field_adapter("fa", MPI_COMM_SELF, make_array_view(dummy_data),
-                                          reverse_classification, in_overlap);
+  XGCFieldAdapter<TestType> field_adapter(
+    "fa", MPI_COMM_SELF, make_array_view(dummy_data), reverse_classification,
+    in_overlap);
   std::cerr<<"getting gids\n";
   auto gids = field_adapter.GetGids();
   REQUIRE(gids.size() == static_cast<size_t>(num_in_overlap));
@@ -129,3 +133,224 @@ TEMPLATE_TEST_CASE("XGC Field Adapter", "[adapter]", pcms::LO, pcms::Real)
   std::cerr<<"check data\n";
   REQUIRE(check_data(dummy_data, reverse_classification, in_overlap, 5) == 0);
 }
+
+TEST_CASE("XGC Field Adapter plane communication", "[adapter]")
+{
+  static constexpr auto data_size = 100;
+  const auto reverse_classification = create_dummy_rc(data_size);
+  const ReverseClassificationVertexCSR<> reverse_classification_csr{
+    reverse_classification};
+  for (auto plane_communication : {pcms::XGCPlaneCommunication::SharedMemory,
+                                   pcms::XGCPlaneCommunication::Distributed}) {
+    std::vector<pcms::Real> dummy_data(data_size);
+    std::iota(dummy_data.begin(), dummy_data.end(), 0);
+    XGCFieldAdapter<pcms::Real> field_adapter(
+      "fa", MPI_COMM_SELF, make_array_view(dummy_data),
+      reverse_classification_csr, in_overlap, plane_communication);
+    REQUIRE(field_adapter.RankParticipatesCouplingCommunication());
+    std::vector<pcms::LO> permutation;
+    std::vector<pcms::Real> buffer(field_adapter.Serialize({}, {}));
+    field_adapter.Serialize(make_array_view(buffer),
+                            make_const_array_view(permutation));
+    for (auto& val : buffer) {
+      val += 5;
+    }
+    field_adapter.Deserialize(make_const_array_view(buffer),
+                              make_const_array_view(permutation));
+    REQUIRE(check_data(dummy_data, reverse_classification, in_overlap, 5) ==
+            0);
+  }
+}
+
+TEST_CASE("XGC Field Adapter evaluation", "[adapter]")
+{
+  // unit square split into two triangles with XGC (1 based) numbering
+  std::vector<pcms::Real> coordinates{0, 0, 1, 0, 1, 1, 0, 1};
+  std::vector<pcms::LO> triangles{1, 2, 3, 1, 3, 4};
+  auto geometry = std::make_shared<pcms::XGCMeshGeometry>(
+    make_const_array_view(coordinates), make_const_array_view(triangles));
+  REQUIRE(geometry->GetNumVerts() == 4);
+  // linear field f = r + 2z
+  std::vector<pcms::Real> data{0, 1, 3, 2};
+  XGCFieldAdapter<pcms::Real> field_adapter(
+    "fa", MPI_COMM_SELF, make_array_view(data),
+    ReverseClassificationVertexCSR<>{create_dummy_rc(4)}, in_overlap);
+  field_adapter.SetGeometry(geometry);
+  auto nodal_coordinates = get_nodal_coordinates(field_adapter);
+  REQUIRE(nodal_coordinates.size() == coordinates.size());
+  REQUIRE(nodal_coordinates(4) == 1.0);
+
+  std::vector<pcms::Real> points{0.25, 0.25, 0.75, 0.5, 0.1, 0.9};
+  auto points_view =
+    pcms::ScalarArrayView<const pcms::Real, pcms::HostMemorySpace>{
+      points.data(), points.size()};
+  SECTION("Lagrange")
+  {
+    auto values = evaluate(field_adapter, pcms::Lagrange<1>{}, points_view);
+    REQUIRE(values.size() == 3);
+    for (int i = 0; i < 3; ++i) {
+      REQUIRE(std::abs(values(i) - (points[2 * i] + 2 * points[2 * i + 1])) <
+              1E-12);
+    }
+  }
+  SECTION("Nearest Neighbor")
+  {
+    auto values = evaluate(field_adapter, pcms::NearestNeighbor{}, points_view);
+    REQUIRE(values.size() == 3);
+    REQUIRE(values(0) == 0);
+    REQUIRE(values(2) == 2);
+  }
+  SECTION("set nodal data")
+  {
+    std::vector<int> new_data{4, 3, 2, 1};
+    set_nodal_data(field_adapter, make_const_array_view(new_data));
+    REQUIRE(data == std::vector<pcms::Real>{4, 3, 2, 1});
+  }
+}
+
+TEST_CASE("XGC Field Adapter shared memory broadcast", "[adapter][mpi]")
+{
+  static constexpr auto data_size = 100;
+  int rank = -1;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  SECTION("windows are shared per communicator")
+  {
+    auto window = pcms::GetNodeSharedMemoryWindow(MPI_COMM_WORLD, 8);
+    REQUIRE(pcms::GetNodeSharedMemoryWindow(MPI_COMM_WORLD, 4) == window);
+    REQUIRE(pcms::GetNodeSharedMemoryWindow(MPI_COMM_WORLD, 16) != window);
+  }
+  SECTION("freed communicators drop their window")
+  {
+    MPI_Comm first = MPI_COMM_NULL;
+    MPI_Comm_dup(MPI_COMM_WORLD, &first);
+    auto first_window = pcms::GetNodeSharedMemoryWindow(first, 8);
+    MPI_Comm_free(&first);
+    // the new communicator may reuse the handle of the freed one
+    MPI_Comm second = MPI_COMM_NULL;
+    MPI_Comm_dup(MPI_COMM_WORLD, &second);
+    auto second_window = pcms::GetNodeSharedMemoryWindow(second, 8);
+    REQUIRE(second_window != first_window);
+    REQUIRE(pcms::GetNodeSharedMemoryWindow(second, 8) == second_window);
+    first_window->Free();
+    second_window->Free();
+    MPI_Comm_free(&second);
+  }
+  SECTION("plane root data is duplicated on every rank")
+  {
+    const auto reverse_classification = create_dummy_rc(data_size);
+    // both fields share the storage of a single converted CSR
+    const ReverseClassificationVertexCSR<> reverse_classification_csr{
+      reverse_classification};
+    // only the plane root starts with the field data
+    std::vector<pcms::Real> real_data(data_size, -1);
+    std::vector<pcms::LO> int_data(data_size, -1);
+    if (rank == 0) {
+      std::iota(real_data.begin(), real_data.end(), 0);
+      std::iota(int_data.begin(), int_data.end(), 0);
+    }
+    XGCFieldAdapter<pcms::Real> real_adapter(
+      "real", MPI_COMM_WORLD, make_array_view(real_data),
+      reverse_classification_csr, in_overlap,
+      pcms::XGCPlaneCommunication::SharedMemory);
+    XGCFieldAdapter<pcms::LO> int_adapter(
+      "int", MPI_COMM_WORLD, make_array_view(int_data),
+      reverse_classification_csr, in_overlap,
+      pcms::XGCPlaneCommunication::SharedMemory);
+    REQUIRE(real_adapter.RankParticipatesCouplingCommunication() ==
+            (rank == 0));
+    std::vector<pcms::LO> permutation;
+    std::vector<pcms::Real> real_buffer(real_adapter.Serialize({}, {}));
+    real_adapter.Serialize(make_array_view(real_buffer),
+                           make_const_array_view(permutation));
+    std::vector<pcms::LO> int_buffer(int_adapter.Serialize({}, {}));
+    int_adapter.Serialize(make_array_view(int_buffer),
+                          make_const_array_view(permutation));
+    for (auto& val : real_buffer) {
+      val += 5;
+    }
+    for (auto& val : int_buffer) {
+      val += 5;
+    }
+    // both fields go through the same window one after the other
+    real_adapter.Deserialize(make_const_array_view(real_buffer),
+                             make_const_array_view(permutation));
+    int_adapter.Deserialize(make_const_array_view(int_buffer),
+                            make_const_array_view(permutation));
+    REQUIRE(check_data(real_data, reverse_classification, in_overlap, 5) ==
+            0);
+    REQUIRE(check_data(int_data, reverse_classification, in_overlap, 5) ==
+            0);
+  }
+}
+
+TEST_CASE("XGC Field Adapter distributed plane", "[adapter][mpi]")
+{
+  static constexpr auto data_size = 101;
+  int rank = -1;
+  int nranks = -1;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+  const auto reverse_classification = create_dummy_rc(data_size);
+  // no rank starts with the field data, so any vertex that is not received
+  // by its owner keeps the initial value
+  std::vector<pcms::Real> data(data_size, -1);
+  XGCFieldAdapter<pcms::Real> field_adapter(
+    "fa", MPI_COMM_WORLD, make_array_view(data),
+    ReverseClassificationVertexCSR<>{reverse_classification}, in_overlap,
+    pcms::XGCPlaneCommunication::Distributed);
+  REQUIRE(field_adapter.RankParticipatesCouplingCommunication());
+
+  // each rank sends a different block of the overlap vertices
+  auto gids = field_adapter.GetGids();
+  REQUIRE(std::is_sorted(gids.begin(), gids.end()));
+  std::vector<pcms::GO> first_gids(nranks, -1);
+  const pcms::GO first_gid = gids.empty() ? -1 : gids.front();
+  MPI_Allgather(&first_gid, 1, MPI_INT64_T, first_gids.data(), 1, MPI_INT64_T,
+                MPI_COMM_WORLD);
+  int num_gids = gids.size();
+  MPI_Allreduce(MPI_IN_PLACE, &num_gids, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+  const auto num_in_overlap = (data_size + 3) / 4;
+  REQUIRE(num_gids == num_in_overlap);
+  for (int i = 0; i < nranks; ++i) {
+    if (i != rank && first_gids[i] != -1) {
+      REQUIRE(std::find(gids.begin(), gids.end(), first_gids[i]) ==
+              gids.end());
+    }
+  }
+  REQUIRE(field_adapter.Serialize({}, {}) == static_cast<int>(gids.size()));
+
+  SECTION("received blocks are assembled on every rank")
+  {
+    // gids are 1 based vertex ids
+    std::vector<pcms::Real> buffer(gids.size());
+    for (size_t i = 0; i < gids.size(); ++i) {
+      buffer[i] = gids[i] - 1 + 5;
+    }
+    std::vector<pcms::LO> permutation;
+    field_adapter.Deserialize(make_const_array_view(buffer),
+                              make_const_array_view(permutation));
+    // create_dummy_rc puts every fourth vertex in the overlap
+    for (int v = 0; v < data_size; ++v) {
+      REQUIRE(data[v] == (v % 4 == 0 ? v + 5 : -1));
+    }
+  }
+  SECTION("reverse partition only contains the owned block")
+  {
+    // overlap vertices go to rank 1 of the other application
+    const redev::ClassPtn partition(MPI_COMM_WORLD, redev::LOs{1, 0},
+                                    redev::ClassPtn::ModelEntVec{{0, 0},
+                                                                 {0, 1}});
+    const auto reverse_partition =
+      field_adapter.GetReversePartitionMap(redev::Partition{partition});
+    if (gids.empty()) {
+      REQUIRE(reverse_partition.empty());
+    } else {
+      REQUIRE(reverse_partition.size() == 1);
+      const auto& idxs = reverse_partition.at(1);
+      REQUIRE(idxs.size() == gids.size());
+      for (size_t i = 0; i < idxs.size(); ++i) {
+        REQUIRE(idxs[i] == static_cast<pcms::LO>(i));
+      }
+    }
+  }
+}
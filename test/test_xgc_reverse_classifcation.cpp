@@ -1,6 +1,8 @@
 #include <pcms/xgc_reverse_classification.h>
 #include <catch2/catch_test_macros.hpp>
 #include <sstream>
+#include <cstdio>
+#include <vector>
 
 static constexpr auto test_data = R"(
 17
@@ -42,3 +44,102 @@ TEST_CASE("reverse classification") {
   rc_deserialized.Deserialize(av);
   REQUIRE(rc_deserialized == rc);
 }
+
+TEST_CASE("reverse classification CSR") {
+  std::stringstream ss{test_data};
+  auto rc = pcms::ReadReverseClassificationVertex(ss);
+  pcms::ReverseClassificationVertexCSR<> csr{rc};
+  REQUIRE(csr.GetNumGeometricEntities() == 6);
+  REQUIRE(csr.GetTotalVerts() == rc.GetTotalVerts());
+  REQUIRE(csr.Find({2, 20}) == -1);
+  REQUIRE(csr.Query({2, 20}).size() == 0);
+  {
+    auto q = csr.Query({2, 1});
+    REQUIRE(q.size() == 3);
+    std::vector<pcms::LO> verts(q.data_handle(), q.data_handle() + q.size());
+    REQUIRE(verts == std::vector<pcms::LO>{4, 5, 6});
+  }
+  // geometric entities are stored in (dim, id) order
+  auto geometry = csr.GetGeometry();
+  for (size_t i = 1; i < geometry.extent(0); ++i) {
+    REQUIRE(((geometry(i - 1).dim < geometry(i).dim) ||
+             (geometry(i - 1).dim == geometry(i).dim &&
+              geometry(i - 1).id < geometry(i).id)));
+  }
+  SECTION("serialization matches the map format") {
+    auto vec = csr.Serialize();
+    pcms::ReverseClassificationVertex rc_deserialized;
+    pcms::ScalarArrayView<pcms::LO, pcms::HostMemorySpace> av{vec.data(),
+                                                              vec.size()};
+    rc_deserialized.Deserialize(av);
+    REQUIRE(rc_deserialized == rc);
+    auto rc_vec = rc.Serialize();
+    pcms::ReverseClassificationVertexCSR<> csr_deserialized;
+    csr_deserialized.Deserialize(pcms::make_const_array_view(rc_vec));
+    REQUIRE(csr_deserialized == csr);
+  }
+  SECTION("parallel construction") {
+    // unsorted classification with a duplicate entry
+    std::vector<pcms::LO> dims{2, 0, 1, 2, 2, 0, 2};
+    std::vector<pcms::LO> ids{1, 1, 11, 1, 1, 2, 1};
+    std::vector<pcms::LO> verts{6, 12, 733, 4, 5, 36, 4};
+    Kokkos::View<const pcms::LO*, pcms::HostMemorySpace> dims_v(dims.data(),
+                                                               dims.size());
+    Kokkos::View<const pcms::LO*, pcms::HostMemorySpace> ids_v(ids.data(),
+                                                              ids.size());
+    Kokkos::View<const pcms::LO*, pcms::HostMemorySpace> verts_v(
+      verts.data(), verts.size());
+    auto built =
+      pcms::ConstructReverseClassificationCSR(dims_v, ids_v, verts_v);
+    REQUIRE(built.GetNumGeometricEntities() == 4);
+    REQUIRE(built.GetTotalVerts() == 6);
+    auto offsets = built.GetOffsets();
+    REQUIRE(offsets(0) == 0);
+    REQUIRE(offsets(4) == 6);
+    auto q = built.Query({2, 1});
+    REQUIRE(q.size() == 3);
+    REQUIRE(q[0] == 4);
+    REQUIRE(q[1] == 5);
+    REQUIRE(q[2] == 6);
+    REQUIRE(built.Query({1, 11})[0] == 733);
+  }
+}
+
+TEST_CASE("reverse classification binary file") {
+  std::stringstream ss{test_data};
+  pcms::ReverseClassificationVertexCSR<> csr{
+    pcms::ReadReverseClassificationVertex(ss)};
+  const std::string filename = "test_reverse_classification.bin";
+  pcms::WriteReverseClassificationVertexBinary(csr, filename);
+  {
+    auto mapped = pcms::MapReverseClassificationVertexBinary(filename);
+    REQUIRE(mapped.GetStorage() != nullptr);
+    REQUIRE(mapped == csr);
+    auto q = mapped.Query({1, 12});
+    REQUIRE(q.size() == 4);
+    REQUIRE(q[0] == 870);
+  }
+  std::remove(filename.c_str());
+}
+
+TEST_CASE("reverse classification CSR broadcast", "[mpi]") {
+  std::stringstream ss{test_data};
+  pcms::ReverseClassificationVertexCSR<> expected{
+    pcms::ReadReverseClassificationVertex(ss)};
+  ss = std::stringstream{test_data};
+  int rank = -1;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  auto rc = pcms::ReadReverseClassificationVertexCSR(ss, MPI_COMM_WORLD);
+  REQUIRE(rc.GetStorage() != nullptr);
+  REQUIRE(rc == expected);
+  // copies that are destroyed in a different order on each rank after the
+  // storage is freed must not communicate
+  std::vector<pcms::ReverseClassificationVertexCSR<>> copies(rank % 2 + 1,
+                                                             rc);
+  pcms::FreeReverseClassificationVertexCSR(rc);
+  if (rank % 2 == 0) {
+    rc = {};
+  } else {
+    copies.clear();
+  }
+}
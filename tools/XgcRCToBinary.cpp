@@ -0,0 +1,18 @@
+#include <pcms/xgc_reverse_classification.h>
+#include <Kokkos_Core.hpp>
+#include <cstdio>
+#include <cstdlib>
+
+int main(int argc, char** argv)
+{
+  if (argc != 3) {
+    printf("Usage: %s <text reverse classification> <binary output>\n",
+           argv[0]);
+    std::abort();
+  }
+  Kokkos::ScopeGuard kokkos(argc, argv);
+  const auto rc = pcms::ReadReverseClassificationVertex(std::string(argv[1]));
+  pcms::WriteReverseClassificationVertexBinary(
+    pcms::ReverseClassificationVertexCSR<>{rc}, argv[2]);
+  return 0;
+}